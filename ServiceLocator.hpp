@@ -21,10 +21,22 @@
 #include <map>
 #include <list>
 #include <set>
+#include <vector>
 #include <typeindex>
 #include <cxxabi.h>
 #include <functional>
 #include <memory>
+#include <tuple>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <type_traits>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <cstddef>
 
 #ifndef SERVICELOCATOR_SPTR
 #define SERVICELOCATOR_SPTR
@@ -41,6 +53,83 @@ template <class T>
 using uptr = std::unique_ptr<T>;
 #endif
 
+// make_sptr constructs the instance and its reference count in a single allocation, define
+// SERVICELOCATOR_MAKE_SPTR along with SERVICELOCATOR_SPTR when supplying a different shared_ptr
+#ifndef SERVICELOCATOR_MAKE_SPTR
+#define SERVICELOCATOR_MAKE_SPTR
+template <class T, class... Args>
+sptr<T> make_sptr(Args&&... args) {
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
+template <class T, class Alloc, class... Args>
+sptr<T> allocate_sptr(const Alloc& alloc, Args&&... args) {
+    return std::allocate_shared<T>(alloc, std::forward<Args>(args)...);
+}
+#endif
+
+// Define SERVICELOCATOR_METRICS to record each binding's resolves, constructions and construction times, see
+// ServiceLocator::getMetrics(), and the dependencies between bindings, see ServiceLocator::exportGraphDot()
+//
+// Define SERVICELOCATOR_TRACE to report every resolve and factory call to a ServiceLocator::TraceSink, see
+// ServiceLocator::setTraceSink().  Without it the trace hooks compile to nothing
+//
+// Define SERVICELOCATOR_STARTUP_PROFILE to time module loading and eager bindings, see
+// ServiceLocator::getStartupProfile()
+//
+// Define SERVICELOCATOR_COUNT_INSTANCES to count the instances each binding constructed which are still alive, see
+// ServiceLocator::getInstanceCounts()
+#if defined(SERVICELOCATOR_METRICS) || defined(SERVICELOCATOR_TRACE) || defined(SERVICELOCATOR_STARTUP_PROFILE)
+#include <chrono>
+#endif
+#ifdef SERVICELOCATOR_METRICS
+#include <sstream>
+#endif
+
+// Replacement operator new / delete calling count (which may use size) for every allocation, expand at namespace
+// scope in exactly 1 translation unit.  Once inlined GCC sees free() called on memory from operator new, which
+// these replacements make correct, so that warning is silenced around them
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#define SERVICELOCATOR_PUSH_NEW_DELETE_DIAGNOSTICS _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wmismatched-new-delete\"")
+#define SERVICELOCATOR_POP_NEW_DELETE_DIAGNOSTICS _Pragma("GCC diagnostic pop")
+#else
+#define SERVICELOCATOR_PUSH_NEW_DELETE_DIAGNOSTICS
+#define SERVICELOCATOR_POP_NEW_DELETE_DIAGNOSTICS
+#endif
+#define SERVICELOCATOR_DEFINE_COUNTING_NEW_DELETE(count) \
+SERVICELOCATOR_PUSH_NEW_DELETE_DIAGNOSTICS \
+void* operator new(std::size_t size) { \
+    count; \
+    void* p = std::malloc(size == 0 ? 1 : size); \
+    if (p == nullptr) { \
+        throw std::bad_alloc(); \
+    } \
+    return p; \
+} \
+void* operator new[](std::size_t size) { \
+    return operator new(size); \
+} \
+void operator delete(void* p) noexcept { \
+    std::free(p); \
+} \
+void operator delete[](void* p) noexcept { \
+    std::free(p); \
+} \
+void operator delete(void* p, std::size_t) noexcept { \
+    std::free(p); \
+} \
+void operator delete[](void* p, std::size_t) noexcept { \
+    std::free(p); \
+} \
+SERVICELOCATOR_POP_NEW_DELETE_DIAGNOSTICS
+
+// Define SERVICELOCATOR_COUNT_ALLOCATIONS to count the heap allocations made while each binding resolves, see
+// ServiceLocator::getAllocationCounts().  The counting operator new / delete are defined by expanding
+// SERVICELOCATOR_DEFINE_ALLOCATION_HOOKS at namespace scope in exactly 1 translation unit
+#ifdef SERVICELOCATOR_COUNT_ALLOCATIONS
+#define SERVICELOCATOR_DEFINE_ALLOCATION_HOOKS SERVICELOCATOR_DEFINE_COUNTING_NEW_DELETE(ServiceLocator::countAllocation(size))
+#endif
+
 class ServiceLocatorException {
 private:
     std::string _message;
@@ -82,254 +171,1690 @@ class ServiceLocator {
 public:
     friend class Context;
     
-    class Context {
-    private:
-        // Only the root Context will run the AfterResolveList - this allows circular dependancies to
-        // resolve by using afterResolve property injection
-        Context* _root;
-        std::list<std::function<void(sptr<Context>)>>* _fnAfterResolveList = nullptr;
+    enum class Lifetime {
+        Transient,
+        Singleton,
+        Instance
+    };
+    
+    // Source of memory for a ServiceLocator's bindings, Contexts and (optionally) instances.  Derive from this
+    // to back a ServiceLocator with a pool or arena, the resource must outlive the ServiceLocator and every
+    // instance allocated from it.  A resource shared between threads must do its own locking
+    class MemoryResource {
+    public:
+        virtual ~MemoryResource() {
+        }
         
-        Context* _parent;
-        wptr<ServiceLocator> _sl;
-        std::type_index _interfaceType;
-        mutable uptr<std::string> _interfaceTypeName;
-        std::string _name;
+        virtual void* allocate(std::size_t bytes, std::size_t alignment) = 0;
+        virtual void deallocate(void* p, std::size_t bytes, std::size_t alignment) = 0;
+    };
+    
+    // The global heap, used when no MemoryResource is supplied.  C++11's operator new only guarantees
+    // alignof(std::max_align_t), an over aligned request is aligned within a larger allocation whose start is
+    // kept just before the memory handed out
+    class NewDeleteResource : public MemoryResource {
+    public:
+        void* allocate(std::size_t bytes, std::size_t alignment) override {
+            if (alignment <= alignof(std::max_align_t)) {
+                return ::operator new(bytes);
+            }
+            auto space = bytes + alignment;
+            auto raw = ::operator new(space + sizeof(void*));
+            void* p = static_cast<char*>(raw) + sizeof(void*);
+            std::align(alignment, bytes, p, space);
+            static_cast<void**>(p)[-1] = raw;
+            return p;
+        }
         
-        uptr<std::type_index> _concreteType;
-        mutable uptr<std::string> _concreteTypeName;
+        void deallocate(void* p, std::size_t, std::size_t alignment) override {
+            if (alignment <= alignof(std::max_align_t)) {
+                ::operator delete(p);
+            } else {
+                ::operator delete(static_cast<void**>(p)[-1]);
+            }
+        }
+    };
+    
+    // Hands out memory from a buffer, growing it from an upstream resource when exhausted, and only releases
+    // memory when destroyed.  Suits per request child locators which are thrown away as a whole
+    class MonotonicBufferResource : public MemoryResource {
+    private:
+        struct chunk {
+            chunk* next;
+            std::size_t size;
+        };
         
+        MemoryResource* _upstream;
+        chunk* _chunks = nullptr;
+        char* _current = nullptr;
+        std::size_t _remaining = 0;
+        std::size_t _nextSize;
         
-        std::string getTypeName(const std::type_index& typeIndex) const {
-            int status;
-            auto s = __cxxabiv1::__cxa_demangle (typeIndex.name(), nullptr, nullptr, &status);
-            std::string result;
-            switch(status) {
-                case 0:
-                    result = std::string(s);
-                    break;
-                case 1:
-                    result = "Memory failure";
-                    break;
-                case 2:
-                    result = "Not a mangled name";
-                    break;
-                case 3:
-                    result = "Invalid arguments";
-                    break;
+        void grow(std::size_t bytes, std::size_t alignment) {
+            auto size = sizeof(chunk) + bytes + alignment;
+            if (size < _nextSize) {
+                size = _nextSize;
             }
-            if (s) {
-                delete s;
-            }
-            return result;
+            auto c = static_cast<chunk*>(_upstream->allocate(size, alignof(chunk)));
+            c->next = _chunks;
+            c->size = size;
+            _chunks = c;
+            _current = reinterpret_cast<char*>(c + 1);
+            _remaining = size - sizeof(chunk);
+            _nextSize = size * 2;
         }
         
-        void checkRecursiveResolve(Context* resolveCtx, Context* compareCtx) {
-            if (resolveCtx->_interfaceType == compareCtx->_interfaceType && resolveCtx->_name == compareCtx->_name) {
-                throw RecursiveResolveException("Recursive resolve path = " + resolveCtx->getResolvePath());
-            }
-            if (compareCtx->_parent != nullptr) {
-                checkRecursiveResolve(resolveCtx, compareCtx->_parent);
+    public:
+        MonotonicBufferResource(std::size_t initialSize = 1024, MemoryResource* upstream = defaultResource()) : _upstream(upstream), _nextSize(initialSize) {
+        }
+        
+        // Allocate from the supplied buffer first, it is not owned and is never released
+        MonotonicBufferResource(void* buffer, std::size_t size, MemoryResource* upstream = defaultResource()) : _upstream(upstream), _current(static_cast<char*>(buffer)), _remaining(size), _nextSize(size > 0 ? size : 1024) {
+        }
+        
+        MonotonicBufferResource(const MonotonicBufferResource&) = delete;
+        MonotonicBufferResource& operator=(const MonotonicBufferResource&) = delete;
+        
+        virtual ~MonotonicBufferResource() {
+            while(_chunks != nullptr) {
+                auto next = _chunks->next;
+                _upstream->deallocate(_chunks, _chunks->size, alignof(chunk));
+                _chunks = next;
             }
         }
-
-        void afterResolve() {
-            if (this == _root) {
-                if (_fnAfterResolveList != nullptr) {
-                    for(auto fn : *_fnAfterResolveList) {
-                        auto ctx = sptr<Context>(new Context(_sl));
-                        fn(ctx);
-                    }
-                    delete _fnAfterResolveList;
-                    _fnAfterResolveList = nullptr;
-                }
+        
+        void* allocate(std::size_t bytes, std::size_t alignment) override {
+            void* p = _current;
+            if (_current == nullptr || std::align(alignment, bytes, p, _remaining) == nullptr) {
+                grow(bytes, alignment);
+                p = _current;
+                std::align(alignment, bytes, p, _remaining);
             }
+            _current = static_cast<char*>(p) + bytes;
+            _remaining -= bytes;
+            return p;
         }
         
+        void deallocate(void*, std::size_t, std::size_t) override {
+        }
+    };
+    
+    static MemoryResource* defaultResource() {
+        static NewDeleteResource resource;
+        return &resource;
+    }
+    
+    // Standard library allocator drawing from a MemoryResource, used for all ServiceLocator containers
+    template <class T>
+    class Allocator {
+        template <class U>
+        friend class Allocator;
+        
+    private:
+        MemoryResource* _resource;
+        
     public:
-        Context(Context* root, Context* parent, wptr<ServiceLocator> sl, const std::type_index interfaceType, const std::string& name) : _root(root), _parent(parent), _sl(sl), _interfaceType(interfaceType), _name(name) {
+        typedef T value_type;
+        
+        Allocator(MemoryResource* resource) : _resource(resource) {
         }
-
-        Context(Context* parent, const std::type_index interfaceType, const std::string& name) : Context(parent->_root, parent, parent->_sl, interfaceType, name) {
+        
+        template <class U>
+        Allocator(const Allocator<U>& other) : _resource(other._resource) {
         }
-
-        Context(wptr<ServiceLocator> sl, const std::type_index interfaceType, const std::string& name) : Context(this, nullptr, sl, interfaceType, name) {
+        
+        T* allocate(std::size_t n) {
+            return static_cast<T*>(_resource->allocate(n * sizeof(T), alignof(T)));
         }
-
-        Context(wptr<ServiceLocator> sl) : Context(this, nullptr, sl, std::type_index(typeid(void)), "") {
+        
+        void deallocate(T* p, std::size_t n) {
+            _resource->deallocate(p, n * sizeof(T), alignof(T));
         }
         
-        const std::string& getName() const {
-            return _name;
+        MemoryResource* resource() const {
+            return _resource;
         }
         
-        const std::string& getInterfaceTypeName() const {
-            if (_interfaceTypeName == nullptr) {
-                _interfaceTypeName = uptr<std::string>(new std::string(getTypeName(_interfaceType)));
-            }
-            return *_interfaceTypeName;
+        template <class U>
+        bool operator==(const Allocator<U>& other) const {
+            return _resource == other._resource;
         }
         
-        const std::type_index& getInterfaceTypeIndex() const {
-            return _interfaceType;
+        template <class U>
+        bool operator!=(const Allocator<U>& other) const {
+            return _resource != other._resource;
+        }
+    };
+    
+    // Runs every task, returning once all of them have completed.  Used to run independent work in parallel
+    typedef std::function<void(const std::vector<std::function<void()>>& tasks)> Executor;
+    
+    // An Executor running each task on its own std::thread
+    static Executor threadExecutor() {
+        return [] (const std::vector<std::function<void()>>& tasks) {
+            std::vector<std::thread> threads;
+            std::vector<std::exception_ptr> errors(tasks.size());
+            for(std::size_t i = 0; i < tasks.size(); i++) {
+                threads.push_back(std::thread([&tasks, &errors, i] () {
+                    try {
+                        tasks[i]();
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                }));
+            }
+            for(auto& thread : threads) {
+                thread.join();
+            }
+            for(auto& error : errors) {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        };
+    }
+    
+    class Context;
+    
+private:
+    class loose_binding;
+    
+public:
+#ifdef SERVICELOCATOR_TRACE
+    // A resolve through a Context, or a binding's factory constructing an instance for a resolve
+    struct TraceEvent {
+        enum class Kind {
+            Resolve,
+            Construct
+        };
+        
+        Kind kind;
+        std::type_index interfaceType;
+        // A copy, so events can be kept after the resolve
+        std::string name;
+        // The number of resolves this one is nested in
+        std::size_t depth;
+        // Only known once the binding is, false for a Resolve's begin()
+        bool bound;
+        Lifetime lifetime;
+        
+        TraceEvent(Kind kind, const std::type_index& interfaceType, std::string name, std::size_t depth, bool bound, Lifetime lifetime) : kind(kind), interfaceType(interfaceType), name(std::move(name)), depth(depth), bound(bound), lifetime(lifetime) {
+        }
+    };
+    
+    // Receives TraceEvents on the thread resolving, so must be thread safe (eg a lock free ring buffer).  end()
+    // is called for every begin(), including when the resolve throws
+    class TraceSink {
+    public:
+        virtual ~TraceSink() {
         }
         
-        void setConcreteType(const std::type_index& concreteType) {
-            if (_concreteType != nullptr) {
-                throw BindingIssueException("Concrete type on Context already set");
+        virtual void begin(const TraceEvent& event) = 0;
+        virtual void end(const TraceEvent& event, std::uint64_t nanos) = 0;
+    };
+    
+    // Report to sink from now on, nullptr to stop.  The sink must outlive any resolve it may be reporting
+    static void setTraceSink(TraceSink* sink) {
+        traceSink().store(sink, std::memory_order_release);
+    }
+    
+private:
+    static std::atomic<TraceSink*>& traceSink() {
+        static std::atomic<TraceSink*> sink(nullptr);
+        return sink;
+    }
+    
+    // Reports a resolve (or with a lifetime, a construction) to the TraceSink from construction to destruction
+    class trace_scope {
+    private:
+        TraceSink* _sink;
+        TraceEvent _event;
+        std::chrono::steady_clock::time_point _start;
+        
+        static std::size_t depthOf(const Context* ctx) {
+            std::size_t depth = 0;
+            for(auto parent = ctx->_parent; parent != nullptr && parent->_parent != nullptr; parent = parent->_parent) {
+                depth++;
             }
-            _concreteType = uptr<std::type_index>(new std::type_index(concreteType));
+            return depth;
         }
         
-        const std::string& getConcreteTypeName() const {
-            if (_concreteTypeName == nullptr) {
-                _concreteTypeName = uptr<std::string>(new std::string(getTypeName(*_concreteType)));
+        // Only copied when there is a sink to report to
+        std::string nameFor(const std::string& name) const {
+            return _sink != nullptr ? name : std::string();
+        }
+        
+    public:
+        trace_scope(const Context* ctx) : _sink(traceSink().load(std::memory_order_acquire)), _event(TraceEvent::Kind::Resolve, ctx->_interfaceType, nameFor(ctx->_name), _sink != nullptr ? depthOf(ctx) : 0, false, Lifetime::Transient) {
+            if (_sink != nullptr) {
+                _sink->begin(_event);
+                _start = std::chrono::steady_clock::now();
             }
-            return *_concreteTypeName;
         }
         
-        const std::type_index& getConcreteTypeIndex() const {
-            return *_concreteType;
+        trace_scope(const Context* ctx, Lifetime lifetime) : _sink(traceSink().load(std::memory_order_acquire)), _event(TraceEvent::Kind::Construct, ctx->_interfaceType, nameFor(ctx->_name), _sink != nullptr ? depthOf(ctx) : 0, true, lifetime) {
+            if (_sink != nullptr) {
+                _sink->begin(_event);
+                _start = std::chrono::steady_clock::now();
+            }
         }
-
-        Context* getParent() const {
-            return _parent;
+        
+        // A resolve from within parent which needs no Context of its own (eg handing out an existing Singleton)
+        trace_scope(const Context* parent, const std::type_index& interfaceType, const std::string& name) : _sink(traceSink().load(std::memory_order_acquire)), _event(TraceEvent::Kind::Resolve, interfaceType, nameFor(name), _sink != nullptr && parent->_parent != nullptr ? depthOf(parent) + 1 : 0, false, Lifetime::Transient) {
+            if (_sink != nullptr) {
+                _sink->begin(_event);
+                _start = std::chrono::steady_clock::now();
+            }
         }
         
-        sptr<ServiceLocator> getServiceLocator() const {
-            return _sl.lock();
+        trace_scope(const trace_scope&) = delete;
+        trace_scope& operator=(const trace_scope&) = delete;
+        
+        ~trace_scope() {
+            if (_sink != nullptr) {
+                _sink->end(_event, (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count());
+            }
         }
         
-        // Resolve a named interface, throws if not able to resolve
-        template <class IFace>
-        sptr<IFace> resolve(const std::string& named) {
-            auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), named));
-            checkRecursiveResolve(ctx.get(), this);
-            auto ptr = _sl.lock()->_resolve<IFace>(ctx);
-            afterResolve();
-            return ptr;
+        // The resolve found binding, nullptr when it found none
+        void bound(const loose_binding* binding) {
+            if (_sink != nullptr && binding != nullptr) {
+                _event.bound = true;
+                _event.lifetime = binding->getLifetime();
+            }
         }
-
-        // Resolve an interface, throws if not able to resolve
-        template <class IFace>
-        sptr<IFace> resolve() {
-            auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), ""));
-            checkRecursiveResolve(ctx.get(), this);
-            auto ptr = _sl.lock()->_resolve<IFace>(ctx);
-            afterResolve();
-            return ptr;
+    };
+#else
+private:
+    class trace_scope {
+    public:
+        trace_scope(const Context*) {
         }
-
-        template <class IFace>
-        void resolveAll(std::vector<sptr<IFace>>* all) {
-            _sl.lock()->_visitAll<IFace>([this, all] (sptr<typename TypedServiceLocator<IFace>::shared_ptr_binding> binding) {
-                auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), ""));
-                checkRecursiveResolve(ctx.get(), this);
-                all->push_back(binding->get(ctx));
-            });
-            afterResolve();
+        
+        trace_scope(const Context*, Lifetime) {
         }
         
-        // Determine if a named interface can be resolved
-        template <class IFace>
-        bool canResolve(const std::string& named) {
-            auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), named));
-            return _sl.lock()->_canResolve<IFace>(ctx);
+        trace_scope(const Context*, const std::type_index&, const std::string&) {
         }
-
-        // Determine if an interface can be resolved
-        template <class IFace>
-        bool canResolve() {
-            auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), ""));
-            return _sl.lock()->_canResolve<IFace>(ctx);
+        
+        void bound(const loose_binding*) {
         }
-
-        // Try to resolve a named interface, returns nullptr on failure
-        template <class IFace>
-        sptr<IFace> tryResolve(const std::string& named) {
-            auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), named));
-            checkRecursiveResolve(ctx.get(), this);
-            auto ptr = _sl.lock()->_tryResolve<IFace>(ctx);
-            afterResolve();
-            return ptr;
+    };
+#endif
+    
+#ifdef SERVICELOCATOR_STARTUP_PROFILE
+public:
+    // A module load, eager binding or the construction of an instance within either of them.  Entries are in the
+    // order they started, an entry's depth is 1 more than the entry it is nested in
+    struct StartupProfileEntry {
+        enum class Kind {
+            Module,
+            EagerBinding,
+            Construct
+        };
+        
+        Kind kind;
+        // The module's type, or the binding's interface and name
+        std::string name;
+        std::size_t depth;
+        std::uint64_t totalNanos;
+        // totalNanos less the time in the entries nested in it
+        std::uint64_t selfNanos;
+    };
+    
+private:
+    // Times a module load or eager binding, and constructions nested in them (a construction with neither
+    // in progress on this thread isn't part of startup so isn't recorded)
+    class startup_scope {
+    private:
+        const ServiceLocator* _sl;
+        startup_scope* _parent;
+        std::size_t _index;
+        std::size_t _depth;
+        std::uint64_t _nestedNanos;
+        std::chrono::steady_clock::time_point _start;
+        
+        static startup_scope*& current() {
+            static thread_local startup_scope* scope = nullptr;
+            return scope;
         }
-
-        // Try to resolve an interface, returns nullptr on failure
-        template <class IFace>
-        sptr<IFace> tryResolve() {
-            auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), ""));
-            checkRecursiveResolve(ctx.get(), this);
-            auto ptr = _sl.lock()->_tryResolve<IFace>(ctx);
-            afterResolve();
-            return ptr;
+        
+        static std::string bindingName(const loose_binding* binding) {
+            auto name = Context::getTypeName(binding->getInterfaceType());
+            return binding->getName().empty() ? name : name + " \"" + binding->getName() + "\"";
         }
         
-        template <class IFace>
-        std::function<sptr<IFace>(const std::string&)> provider() {
-            // We lock the weak_ptr to our ServiceLocator, the lock returns a shared_ptr which will keep
-            // it alive into the returned lambda via the capture of sl
-            auto sl = _sl.lock();
-            return [sl] (const std::string& name = "") {
-                auto ctx = sptr<Context>(new Context(sl, std::type_index(typeid(IFace)), name));
-                // Don't need to check for recursive resolve since this is a provider (root) call
-                auto ptr = sl->_resolve<IFace>(ctx);
-                // ctx is root Context, it can afterResolve
-                ctx->afterResolve();
-                return ptr;
-            };
+        void start(const ServiceLocator* sl, StartupProfileEntry::Kind kind, const std::string& name) {
+            _sl = sl;
+            _parent = current();
+            _depth = _parent != nullptr ? _parent->_depth + 1 : 0;
+            _nestedNanos = 0;
+            {
+                std::lock_guard<std::mutex> lock(_sl->_startupProfileMutex);
+                _index = _sl->_startupProfile.size();
+                _sl->_startupProfile.push_back(StartupProfileEntry { kind, name, _depth, 0, 0 });
+            }
+            current() = this;
+            _start = std::chrono::steady_clock::now();
         }
         
-        template <class IFace>
-        std::function<sptr<IFace>(const std::string&)> tryProvider() {
-            // We lock the weak_ptr to our ServiceLocator, the lock returns a shared_ptr which will keep
-            // it alive into the returned lambda via the capture of sl
-            auto sl = _sl.lock();
-            return [sl] (const std::string& name = "") {
-                auto ctx = sptr<Context>(new Context(sl, std::type_index(typeid(IFace)), name));
-                // Don't need to check for recursive resolve since this is a tryProvider (root) call
-                auto ptr = sl->_tryResolve<IFace>(ctx);
-                // ctx is root Context, it can afterResolve
-                ctx->afterResolve();
-                return ptr;
-            };
+    public:
+        startup_scope(const ServiceLocator* sl, const std::type_info& moduleType) {
+            start(sl, StartupProfileEntry::Kind::Module, Context::getTypeName(std::type_index(moduleType)));
         }
         
-        std::string getResolvePath() const {
-            std::string path = "";
-            // Note the root Parent has a <ServiceLocator> IFace which is not real, just cannot have no interface defined
-            if (_parent != nullptr && _parent->_parent != nullptr) {
-                path = _parent->getResolvePath() + " -> ";
-            }
-            
-            path += "resolve<" + getInterfaceTypeName() + ">(" + _name + ")";
-
-            if (_concreteType != nullptr) {
-                path += ".to<" + getConcreteTypeName() + ">";
+        startup_scope(const ServiceLocator* sl, const loose_binding* eagerBinding) {
+            start(sl, StartupProfileEntry::Kind::EagerBinding, bindingName(eagerBinding));
+        }
+        
+        // Recorded against the profile of the module load or eager binding it is nested in
+        startup_scope(const loose_binding* constructing) : _sl(nullptr) {
+            if (current() != nullptr) {
+                start(current()->_sl, StartupProfileEntry::Kind::Construct, bindingName(constructing));
             }
-            
-            return path;
         }
         
-        void afterResolve(std::function<void(sptr<Context>)> fnAfterResolve) {
-            if (_root->_fnAfterResolveList == nullptr) {
-                _root->_fnAfterResolveList = new std::list<std::function<void(sptr<Context>)>>();
+        startup_scope(const startup_scope&) = delete;
+        startup_scope& operator=(const startup_scope&) = delete;
+        
+        ~startup_scope() {
+            if (_sl == nullptr) {
+                return;
             }
-            _root->_fnAfterResolveList->push_back(fnAfterResolve);
+            auto nanos = (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+            current() = _parent;
+            if (_parent != nullptr) {
+                _parent->_nestedNanos += nanos;
+            }
+            std::lock_guard<std::mutex> lock(_sl->_startupProfileMutex);
+            auto& entry = _sl->_startupProfile[_index];
+            entry.totalNanos = nanos;
+            entry.selfNanos = nanos > _nestedNanos ? nanos - _nestedNanos : 0;
         }
     };
-    
-private:
-    class AnyServiceLocator {
+#else
+    class startup_scope {
     public:
-        virtual ~AnyServiceLocator() {
+        startup_scope(const ServiceLocator*, const std::type_info&) {
         }
         
-        class loose_binding {
-        public:
-            virtual ~loose_binding() {
-            }
-            
-            virtual void eagerBind(sptr<Context> slc) = 0;
-        };
+        startup_scope(const ServiceLocator*, const loose_binding*) {
+        }
+        
+        startup_scope(const loose_binding*) {
+        }
+    };
+#endif
+
+    template <class IFace>
+    class binding_handle;
+
+    // A callable held in place when it fits in Size bytes (every built in factory does), otherwise on the heap.
+    // Unlike std::function a small capture never allocates, and calling it is a single indirect call
+    template <class Signature, std::size_t Size = 4 * sizeof(void*)>
+    class inline_function;
+
+    template <class R, class... Args, std::size_t Size>
+    class inline_function<R(Args...), Size> {
+    private:
+        typedef typename std::aligned_storage<Size>::type storage_type;
+
+        struct operations {
+            R (*invoke)(void* storage, Args... args);
+            void (*copy)(const void* from, void* to);
+            void (*move)(void* from, void* to);
+            void (*destroy)(void* storage);
+        };
+
+        template <class Fn, bool Inline = sizeof(Fn) <= sizeof(storage_type) && std::alignment_of<Fn>::value <= std::alignment_of<storage_type>::value && std::is_nothrow_move_constructible<Fn>::value>
+        struct manager {
+            static Fn* get(void* storage) {
+                return static_cast<Fn*>(storage);
+            }
+
+            static void create(void* storage, Fn&& fn) {
+                new (storage) Fn(std::move(fn));
+            }
+
+            static R invoke(void* storage, Args... args) {
+                return (*get(storage))(std::forward<Args>(args)...);
+            }
+
+            static void copy(const void* from, void* to) {
+                new (to) Fn(*static_cast<const Fn*>(from));
+            }
+
+            static void move(void* from, void* to) {
+                new (to) Fn(std::move(*get(from)));
+                get(from)->~Fn();
+            }
+
+            static void destroy(void* storage) {
+                get(storage)->~Fn();
+            }
+
+            static const operations* table() {
+                static const operations ops = { &invoke, &copy, &move, &destroy };
+                return &ops;
+            }
+        };
+
+        // Too big (or not safe to move in place), the storage holds a pointer to a heap copy
+        template <class Fn>
+        struct manager<Fn, false> {
+            static Fn*& get(void* storage) {
+                return *static_cast<Fn**>(storage);
+            }
+
+            static void create(void* storage, Fn&& fn) {
+                new (storage) Fn*(new Fn(std::move(fn)));
+            }
+
+            static R invoke(void* storage, Args... args) {
+                return (*get(storage))(std::forward<Args>(args)...);
+            }
+
+            static void copy(const void* from, void* to) {
+                new (to) Fn*(new Fn(**static_cast<Fn* const*>(from)));
+            }
+
+            static void move(void* from, void* to) {
+                new (to) Fn*(get(from));
+            }
+
+            static void destroy(void* storage) {
+                delete get(storage);
+            }
+
+            static const operations* table() {
+                static const operations ops = { &invoke, &copy, &move, &destroy };
+                return &ops;
+            }
+        };
+
+        // mutable as the held callable need not have a const call operator
+        mutable storage_type _storage;
+        const operations* _ops;
+
+    public:
+        inline_function() : _ops(nullptr) {
+        }
+
+        inline_function(std::nullptr_t) : _ops(nullptr) {
+        }
+
+        template <class Fn, class = typename std::enable_if<!std::is_same<typename std::decay<Fn>::type, inline_function>::value>::type>
+        inline_function(Fn fn) : _ops(manager<Fn>::table()) {
+            manager<Fn>::create(&_storage, std::move(fn));
+        }
+
+        inline_function(const inline_function& other) : _ops(other._ops) {
+            if (_ops != nullptr) {
+                _ops->copy(&other._storage, &_storage);
+            }
+        }
+
+        inline_function(inline_function&& other) : _ops(other._ops) {
+            if (_ops != nullptr) {
+                _ops->move(&other._storage, &_storage);
+                other._ops = nullptr;
+            }
+        }
+
+        ~inline_function() {
+            if (_ops != nullptr) {
+                _ops->destroy(&_storage);
+            }
+        }
+
+        inline_function& operator=(inline_function other) {
+            if (_ops != nullptr) {
+                _ops->destroy(&_storage);
+            }
+            _ops = other._ops;
+            if (_ops != nullptr) {
+                _ops->move(&other._storage, &_storage);
+                other._ops = nullptr;
+            }
+            return *this;
+        }
+
+        explicit operator bool() const {
+            return _ops != nullptr;
+        }
+
+        // Throws std::bad_function_call when empty, as std::function does
+        R operator()(Args... args) const {
+            if (_ops == nullptr) {
+                throw std::bad_function_call();
+            }
+            return _ops->invoke(&_storage, std::forward<Args>(args)...);
+        }
+    };
+
+public:
+    template <class IFace>
+    class Plan;
+    
+    template <class IFace>
+    class Factory;
+    
+    template <class IFace>
+    class Lazy;
+    
+    template <class IFace>
+    class ResolveAllRange;
+    
+    // A Context must not outlive the ServiceLocator it came from: it holds a plain pointer to it, so
+    // getServiceLocator() and resolving through a Context whose ServiceLocator has been destroyed is undefined
+    // behaviour.  Keep the ServiceLocator (or a child of it) alive for as long as its Contexts
+    class Context {
+        friend class ServiceLocator;
+        
+        template <class IFace>
+        friend class Plan;
+        
+        template <class IFace>
+        friend class Factory;
+        
+        template <class IFace>
+        friend class Lazy;
+        
+        template <class IFace>
+        friend class ResolveAllRange;
+        
+    private:
+        typedef inline_function<void(const sptr<Context>&)> after_resolve_fn;
+        typedef std::list<after_resolve_fn, Allocator<after_resolve_fn>> after_resolve_list;
+        
+        // Only the root Context will run the AfterResolveList - this allows circular dependancies to
+        // resolve by using afterResolve property injection
+        Context* _root;
+        after_resolve_list _fnAfterResolveList;
+        
+        Context* _parent;
+        // A plain pointer, copying a weak_ptr here would touch the ServiceLocator's shared reference count on
+        // every resolve.  Hence a Context must not outlive its ServiceLocator (see above)
+        ServiceLocator* _sl;
+        MemoryResource* _resource;
+        // The Singleton whose construction this resolve is part of, anything Singleton it resolves becomes a
+        // dependency of it (see ServiceLocator::shutdown)
+        loose_binding* _dependant = nullptr;
+#ifdef SERVICELOCATOR_METRICS
+        // The binding resolving through us, the bindings resolved through our children are its dependencies
+        loose_binding* _binding = nullptr;
+        // While retargeted, the binding we were made for - what resolves through us in its place is its dependency
+        loose_binding* _retargetedFrom = nullptr;
+#endif
+        std::type_index _interfaceType;
+        mutable uptr<std::string> _interfaceTypeName;
+        std::string _name;
+        
+        uptr<std::type_index> _concreteType;
+        std::size_t _concreteSize = 0;
+        mutable uptr<std::string> _concreteTypeName;
+        
+        // A resolve recorded by a Plan, subtree counts the steps recorded while resolving this one
+        struct plan_step {
+            std::type_index interfaceType;
+            std::string name;
+            loose_binding* binding;
+            std::size_t subtree;
+        };
+        typedef std::vector<plan_step> plan_steps;
+        
+        // Where a Plan is up to, either replaying steps or recording them
+        struct plan_cursor {
+            const plan_steps* steps;
+            plan_steps* recording;
+            std::size_t next;
+        };
+        
+        // Only set on the root Context of a Plan's execute()
+        plan_cursor* _plan = nullptr;
+        
+        // Every resolve comes through here, fnResolve(binding) looks up the binding (setting it) and resolves
+        // from it, fnGet(binding) resolves from an already known binding.  While a Plan replays, a resolve
+        // matching the next recorded step goes straight to its binding - the lookup and recursive resolve check
+        // are skipped as the recorded path had no recursion
+        template <class IFace, class FnResolve, class FnGet>
+        auto resolveStep(Context* ctx, FnResolve fnResolve, FnGet fnGet) -> decltype(fnGet(nullptr)) {
+            typedef typename TypedServiceLocator<IFace>::shared_ptr_binding binding_type;
+            binding_type* binding = nullptr;
+            trace_scope trace(ctx);
+            auto plan = _root->_plan;
+            if (plan != nullptr && plan->steps != nullptr) {
+                auto index = plan->next;
+                if (index < plan->steps->size()) {
+                    auto& step = (*plan->steps)[index];
+                    // binding is only null when recording the step threw
+                    if (step.binding != nullptr && step.interfaceType == ctx->_interfaceType && step.name == ctx->_name) {
+                        plan->next = index + 1;
+                        binding = static_cast<binding_type*>(step.binding);
+                        trace.bound(binding);
+                        auto&& result = fnGet(binding);
+                        // A Singleton created before this execute skips the steps which created it
+                        plan->next = index + 1 + step.subtree;
+                        return std::forward<decltype(result)>(result);
+                    }
+                }
+                // The factories took a different path to the recorded one, resolve normally from here on
+                _root->_plan = nullptr;
+                plan = nullptr;
+            }
+            
+            checkRecursiveResolve(ctx, this);
+            if (plan == nullptr) {
+                auto&& result = fnResolve(binding);
+                trace.bound(binding);
+                return std::forward<decltype(result)>(result);
+            }
+            
+            auto index = plan->recording->size();
+            plan->recording->push_back(plan_step { ctx->_interfaceType, ctx->_name, nullptr, 0 });
+            auto&& result = fnResolve(binding);
+            trace.bound(binding);
+            auto& step = (*plan->recording)[index];
+            step.binding = binding;
+            step.subtree = plan->recording->size() - index - 1;
+            return std::forward<decltype(result)>(result);
+        }
+        
+        static std::string getTypeName(const std::type_index& typeIndex) {
+            int status;
+            auto s = __cxxabiv1::__cxa_demangle (typeIndex.name(), nullptr, nullptr, &status);
+            std::string result;
+            switch(status) {
+                case 0:
+                    result = std::string(s);
+                    break;
+                case 1:
+                    result = "Memory failure";
+                    break;
+                case 2:
+                    result = "Not a mangled name";
+                    break;
+                case 3:
+                    result = "Invalid arguments";
+                    break;
+            }
+            // __cxa_demangle mallocs its result
+            std::free(s);
+            return result;
+        }
+        
+        void checkRecursiveResolve(Context* resolveCtx, Context* compareCtx) {
+            if (resolveCtx->_interfaceType == compareCtx->_interfaceType && resolveCtx->_name == compareCtx->_name) {
+                throw RecursiveResolveException("Recursive resolve path = " + resolveCtx->getResolvePath());
+            }
+            if (compareCtx->_parent != nullptr) {
+                checkRecursiveResolve(resolveCtx, compareCtx->_parent);
+            }
+        }
+
+        // The type names are cached on first use, fill them for us and our parents before sharing the path
+        // between threads
+        void fillTypeNames() const {
+            for(auto ctx = this; ctx != nullptr; ctx = ctx->_parent) {
+                ctx->getInterfaceTypeName();
+                if (ctx->_concreteType != nullptr) {
+                    ctx->getConcreteTypeName();
+                }
+            }
+        }
+        
+        void afterResolve() {
+            if (this == _root) {
+                while(!_fnAfterResolveList.empty()) {
+                    auto fn = std::move(_fnAfterResolveList.front());
+                    _fnAfterResolveList.pop_front();
+                    auto ctx = makeContext(_resource, _sl);
+                    fn(ctx);
+                }
+            }
+        }
+        
+        // Contexts are allocated from the ServiceLocator's MemoryResource
+        template <class... Args>
+        static sptr<Context> makeContext(MemoryResource* resource, Args&&... args) {
+            return allocate_sptr<Context>(Allocator<Context>(resource), std::forward<Args>(args)...);
+        }
+        
+        // Resolves another interface and name through a Context in place of the one it was made for, saving a
+        // child Context, and restores it on the way out (see alias)
+        class retarget_scope {
+        private:
+            Context* _ctx;
+            std::type_index _interfaceType;
+            std::string _name;
+            uptr<std::string> _interfaceTypeName;
+            loose_binding* _dependant;
+#ifdef SERVICELOCATOR_METRICS
+            loose_binding* _binding;
+            loose_binding* _retargetedFrom;
+#endif
+            
+        public:
+            retarget_scope(Context* ctx, const std::type_index& interfaceType, const std::string& name) : _ctx(ctx), _interfaceType(ctx->_interfaceType), _name(std::move(ctx->_name)), _interfaceTypeName(std::move(ctx->_interfaceTypeName)), _dependant(ctx->_dependant) {
+                ctx->_interfaceType = interfaceType;
+                ctx->_name = name;
+#ifdef SERVICELOCATOR_METRICS
+                _binding = ctx->_binding;
+                _retargetedFrom = ctx->_retargetedFrom;
+                ctx->_retargetedFrom = ctx->_binding;
+#endif
+            }
+            
+            retarget_scope(const retarget_scope&) = delete;
+            retarget_scope& operator=(const retarget_scope&) = delete;
+            
+            ~retarget_scope() {
+                _ctx->_interfaceType = _interfaceType;
+                _ctx->_name = std::move(_name);
+                _ctx->_interfaceTypeName = std::move(_interfaceTypeName);
+                _ctx->_dependant = _dependant;
+#ifdef SERVICELOCATOR_METRICS
+                _ctx->_binding = _binding;
+                _ctx->_retargetedFrom = _retargetedFrom;
+#endif
+            }
+        };
+        
+    public:
+        Context(Context* root, Context* parent, ServiceLocator* sl, const std::type_index interfaceType, const std::string& name) : _root(root), _fnAfterResolveList(Allocator<after_resolve_fn>(sl->_resource)), _parent(parent), _sl(sl), _resource(sl->_resource), _interfaceType(interfaceType), _name(name) {
+        }
+
+        Context(Context* parent, const std::type_index interfaceType, const std::string& name) : Context(parent->_root, parent, parent->_sl, interfaceType, name) {
+            _dependant = parent->_dependant;
+        }
+
+        Context(ServiceLocator* sl, const std::type_index interfaceType, const std::string& name) : Context(this, nullptr, sl, interfaceType, name) {
+        }
+
+        Context(ServiceLocator* sl) : Context(this, nullptr, sl, std::type_index(typeid(void)), "") {
+        }
+        
+        // A root of its own below parent, so a task on another thread can resolve (and run its afterResolve
+        // functions) without touching parent's state, while still seeing the resolve path for recursion checks
+        Context(Context* parent, const std::type_index interfaceType, const std::string& name, bool /* taskRoot */) : Context(this, parent, parent->_sl, interfaceType, name) {
+            _dependant = parent->_dependant;
+        }
+        
+        const std::string& getName() const {
+            return _name;
+        }
+        
+        const std::string& getInterfaceTypeName() const {
+            if (_interfaceTypeName == nullptr) {
+                _interfaceTypeName = uptr<std::string>(new std::string(getTypeName(_interfaceType)));
+            }
+            return *_interfaceTypeName;
+        }
+        
+        const std::type_index& getInterfaceTypeIndex() const {
+            return _interfaceType;
+        }
+        
+        void setConcreteType(const std::type_index& concreteType) {
+            if (_concreteType != nullptr) {
+                throw BindingIssueException("Concrete type on Context already set");
+            }
+            _concreteType = uptr<std::type_index>(new std::type_index(concreteType));
+        }
+        
+        // As above, also noting the size of the instance (see SERVICELOCATOR_COUNT_INSTANCES)
+        template <class TImpl>
+        void setConcreteType() {
+            setConcreteType(std::type_index(typeid(TImpl)));
+            _concreteSize = sizeof(TImpl);
+        }
+        
+        const std::string& getConcreteTypeName() const {
+            if (_concreteTypeName == nullptr) {
+                _concreteTypeName = uptr<std::string>(new std::string(getTypeName(*_concreteType)));
+            }
+            return *_concreteTypeName;
+        }
+        
+        const std::type_index& getConcreteTypeIndex() const {
+            return *_concreteType;
+        }
+
+        Context* getParent() const {
+            return _parent;
+        }
+        
+        // Only valid while our ServiceLocator is alive (see above), unlike a weak_ptr it can't report it is gone
+        sptr<ServiceLocator> getServiceLocator() const {
+            return _sl->_this.lock();
+        }
+        
+        // Resolve a named interface, throws if not able to resolve
+        template <class IFace>
+        sptr<IFace> resolve(const std::string& named) {
+            typedef typename TypedServiceLocator<IFace>::shared_ptr_binding binding_type;
+            auto ctx = makeContext(_resource, this, std::type_index(typeid(IFace)), named);
+            auto ptr = resolveStep<IFace>(ctx.get(), [this, &ctx] (binding_type*& binding) {
+                return _sl->_resolve<IFace>(ctx, binding);
+            }, [&ctx] (binding_type* binding) {
+                return _resolveFrom<IFace>(binding, ctx);
+            });
+            afterResolve();
+            return ptr;
+        }
+
+        // Resolve an interface, throws if not able to resolve
+        template <class IFace>
+        sptr<IFace> resolve() {
+            return resolve<IFace>("");
+        }
+
+        // Resolve through a binding_handle, the binding lookup is skipped while the handle's cached binding is current
+        template <class IFace>
+        sptr<IFace> resolveWith(binding_handle<IFace>& handle) {
+            typedef typename TypedServiceLocator<IFace>::shared_ptr_binding binding_type;
+            auto ctx = makeContext(_resource, this, std::type_index(typeid(IFace)), handle.getName());
+            auto ptr = resolveStep<IFace>(ctx.get(), [this, &ctx, &handle] (binding_type*& binding) {
+                binding = handle.find(_sl);
+                if (binding == nullptr) {
+                    throw UnableToResolveException(std::string("Unable to resolve <") + ctx->getInterfaceTypeName() + ">  resolve path = " + ctx->getResolvePath());
+                }
+                return _resolveFrom<IFace>(binding, ctx);
+            }, [&ctx] (binding_type* binding) {
+                return _resolveFrom<IFace>(binding, ctx);
+            });
+            afterResolve();
+            return ptr;
+        }
+        
+        template <class IFace>
+        uptr<IFace> resolveUniqueWith(binding_handle<IFace>& handle) {
+            typedef typename TypedServiceLocator<IFace>::shared_ptr_binding binding_type;
+            auto ctx = makeContext(_resource, this, std::type_index(typeid(IFace)), handle.getName());
+            auto ptr = resolveStep<IFace>(ctx.get(), [this, &ctx, &handle] (binding_type*& binding) {
+                binding = handle.find(_sl);
+                if (binding == nullptr) {
+                    throw UnableToResolveException(std::string("Unable to resolve <") + ctx->getInterfaceTypeName() + ">  resolve path = " + ctx->getResolvePath());
+                }
+                return binding->getUnique(ctx);
+            }, [&ctx] (binding_type* binding) {
+                return binding->getUnique(ctx);
+            });
+            afterResolve();
+            return ptr;
+        }
+        
+        // Resolve a named transient interface to an instance the caller solely owns, throws if not able to resolve or
+        // the binding cannot create unique instances (see toUnique)
+        template <class IFace>
+        uptr<IFace> resolveUnique(const std::string& named) {
+            typedef typename TypedServiceLocator<IFace>::shared_ptr_binding binding_type;
+            auto ctx = makeContext(_resource, this, std::type_index(typeid(IFace)), named);
+            auto ptr = resolveStep<IFace>(ctx.get(), [this, &ctx] (binding_type*& binding) {
+                return _sl->_resolveUnique<IFace>(ctx, binding);
+            }, [&ctx] (binding_type* binding) {
+                return binding->getUnique(ctx);
+            });
+            afterResolve();
+            return ptr;
+        }
+
+        // Resolve a transient interface to an instance the caller solely owns
+        template <class IFace>
+        uptr<IFace> resolveUnique() {
+            return resolveUnique<IFace>("");
+        }
+
+        // Resolve a named Singleton or Instance binding by reference, the instance is held by the ServiceLocator
+        // which owns the binding so no reference counting is needed.  A Singleton's reference is only valid until
+        // that ServiceLocator is shut down (see shutdown, also called by its destructor).  Throws if not able to
+        // resolve or the binding is transient
+        template <class IFace>
+        IFace& resolveRef(const std::string& named) {
+            typedef typename TypedServiceLocator<IFace>::shared_ptr_binding binding_type;
+            auto ctx = makeContext(_resource, this, std::type_index(typeid(IFace)), named);
+            auto& ref = resolveStep<IFace>(ctx.get(), [this, &ctx] (binding_type*& binding) -> IFace& {
+                return _sl->_resolveRef<IFace>(ctx, binding);
+            }, [&ctx] (binding_type* binding) -> IFace& {
+                return binding->getRef(ctx);
+            });
+            afterResolve();
+            return ref;
+        }
+
+        // Resolve a Singleton or Instance binding by reference
+        template <class IFace>
+        IFace& resolveRef() {
+            return resolveRef<IFace>("");
+        }
+
+        // A Lazy<IFace> resolving a named interface when first used.  The binding is found now (throws if there is
+        // none) but nothing is constructed until the Lazy is dereferenced, which resolves it as a root resolve
+        template <class IFace>
+        Lazy<IFace> resolveLazy(const std::string& named) {
+            auto binding = _sl->_findBinding<IFace>(named);
+            if (binding == nullptr) {
+                throw UnableToResolveException(std::string("Unable to resolve <") + getTypeName(std::type_index(typeid(IFace))) + ">  resolve path = " + getResolvePath());
+            }
+            return Lazy<IFace>(getServiceLocator(), binding, named);
+        }
+
+        template <class IFace>
+        Lazy<IFace> resolveLazy() {
+            return resolveLazy<IFace>("");
+        }
+
+        template <class IFace>
+        Lazy<IFace> resolveLazyWith(binding_handle<IFace>& handle) {
+            auto binding = handle.find(_sl);
+            if (binding == nullptr) {
+                throw UnableToResolveException(std::string("Unable to resolve <") + getTypeName(std::type_index(typeid(IFace))) + ">  resolve path = " + getResolvePath());
+            }
+            return Lazy<IFace>(getServiceLocator(), binding, handle.getName());
+        }
+
+        // Append n instances of a named interface to out.  The binding is looked up once and the instances
+        // created from 1 Context.  A Singleton or Instance binding appends the same instance n times.
+        //
+        // With sharedAllocation the built in factories (toSelf(), to<TImpl>() ..) construct the n instances in 1
+        // allocation.  They then share 1 reference count, so none of them is destroyed until the last of them is
+        // released - don't use it for instances which must be destroyed as soon as they are done with (eg ones
+        // holding a socket or file)
+        template <class IFace>
+        void resolveMany(const std::string& named, std::size_t n, std::vector<sptr<IFace>>* out, bool sharedAllocation = false) {
+            auto ctx = makeContext(_resource, this, std::type_index(typeid(IFace)), named);
+            trace_scope trace(ctx.get());
+            checkRecursiveResolve(ctx.get(), this);
+            auto binding = _sl->_findBinding<IFace>(named);
+            if (binding == nullptr) {
+                throw UnableToResolveException(std::string("Unable to resolve <") + ctx->getInterfaceTypeName() + ">  resolve path = " + ctx->getResolvePath());
+            }
+            trace.bound(binding);
+            out->reserve(out->size() + n);
+            binding->getMany(ctx, n, out, sharedAllocation);
+            afterResolve();
+        }
+        
+        template <class IFace>
+        void resolveMany(std::size_t n, std::vector<sptr<IFace>>* out, bool sharedAllocation = false) {
+            resolveMany<IFace>("", n, out, sharedAllocation);
+        }
+        
+        // Resolve every binding of an interface, from our ServiceLocator then its parents
+        template <class IFace>
+        void resolveAll(std::vector<sptr<IFace>>* all) {
+            auto range = resolveAllRange<IFace>();
+            for(auto it = range.begin(); it != range.end(); ++it) {
+                all->push_back(it.resolve());
+            }
+            afterResolve();
+        }
+        
+        // As resolveAll, constructing the instances concurrently on executor - for transient bindings whose
+        // constructors block (eg on I/O).  Already created Singletons and Instances are appended directly, the
+        // order is the same as resolveAll's.  The first exception a task throws is rethrown once all have
+        // finished, and nothing is appended.
+        // This can't be checked, so the caller must ensure: the factories (and anything they resolve) are safe to
+        // run concurrently with each other, and the ServiceLocator's MemoryResource is thread safe as the tasks
+        // allocate Contexts from it.  Singletons the tasks share are created once, as usual
+        template <class IFace>
+        void resolveAll(std::vector<sptr<IFace>>* all, const Executor& executor) {
+            typedef typename TypedServiceLocator<IFace>::shared_ptr_binding binding_type;
+            std::vector<binding_type*> bindings;
+            auto range = resolveAllRange<IFace>();
+            for(auto it = range.begin(); it != range.end(); ++it) {
+                bindings.push_back(it.binding());
+            }
+            
+            std::vector<sptr<IFace>> results(bindings.size());
+            std::vector<std::function<void()>> tasks;
+            for(std::size_t i = 0; i < bindings.size(); i++) {
+                auto binding = bindings[i];
+                if (_dependant == nullptr) {
+                    const sptr<IFace>* instance = binding->existingInstance();
+                    if (instance != nullptr) {
+                        trace_scope trace(this, std::type_index(typeid(IFace)), binding->getName());
+                        trace.bound(binding);
+                        binding->metricsResolvedExisting(this);
+                        results[i] = *instance;
+                        continue;
+                    }
+                }
+                auto slot = &results[i];
+                tasks.push_back([this, binding, slot] () {
+                    auto ctx = makeContext(_resource, this, std::type_index(typeid(IFace)), binding->getName(), true);
+                    trace_scope trace(ctx.get());
+                    trace.bound(binding);
+                    checkRecursiveResolve(ctx.get(), this);
+                    *slot = binding->get(ctx);
+                    ctx->afterResolve();
+                });
+            }
+            if (!tasks.empty()) {
+                // The tasks read our resolve path concurrently for recursion checks and errors
+                fillTypeNames();
+                executor(tasks);
+            }
+            
+            all->reserve(all->size() + results.size());
+            for(auto& ptr : results) {
+                all->push_back(std::move(ptr));
+            }
+        }
+        
+        // As resolveAll, returning a shared immutable array.  When every binding is a Singleton or Instance the
+        // array is cached and returned as is until a new binding could change it
+        template <class IFace>
+        sptr<const std::vector<sptr<IFace>>> resolveAllShared() {
+            return _sl->_resolveAllShared<IFace>(this);
+        }
+        
+        // As resolveAll, without collecting the instances - each is resolved as iteration reaches it (dereferencing
+        // again resolves again).  The range must not outlive this Context
+        template <class IFace>
+        ResolveAllRange<IFace> resolveAllRange() {
+            return ResolveAllRange<IFace>(this);
+        }
+        
+        // Determine if a named interface can be resolved
+        template <class IFace>
+        bool canResolve(const std::string& named) {
+            auto ctx = makeContext(_resource, this, std::type_index(typeid(IFace)), named);
+            return _sl->_canResolve<IFace>(ctx);
+        }
+
+        // Determine if an interface can be resolved
+        template <class IFace>
+        bool canResolve() {
+            auto ctx = makeContext(_resource, this, std::type_index(typeid(IFace)), "");
+            return _sl->_canResolve<IFace>(ctx);
+        }
+
+        // Try to resolve a named interface, returns nullptr on failure
+        template <class IFace>
+        sptr<IFace> tryResolve(const std::string& named) {
+            typename TypedServiceLocator<IFace>::shared_ptr_binding* binding = nullptr;
+            auto ctx = makeContext(_resource, this, std::type_index(typeid(IFace)), named);
+            trace_scope trace(ctx.get());
+            checkRecursiveResolve(ctx.get(), this);
+            auto ptr = _sl->_tryResolve<IFace>(ctx, binding);
+            trace.bound(binding);
+            afterResolve();
+            return ptr;
+        }
+
+        // Try to resolve an interface, returns nullptr on failure
+        template <class IFace>
+        sptr<IFace> tryResolve() {
+            return tryResolve<IFace>("");
+        }
+        
+        template <class IFace>
+        std::function<sptr<IFace>(const std::string&)> provider() {
+            // We lock the weak_ptr to our ServiceLocator, the lock returns a shared_ptr which will keep
+            // it alive into the returned lambda via the capture of sl
+            auto sl = getServiceLocator();
+            return [sl] (const std::string& name) {
+                typename TypedServiceLocator<IFace>::shared_ptr_binding* binding = nullptr;
+                auto ctx = makeContext(sl->_resource, sl.get(), std::type_index(typeid(IFace)), name);
+                trace_scope trace(ctx.get());
+                // Don't need to check for recursive resolve since this is a provider (root) call
+                auto ptr = sl->_resolve<IFace>(ctx, binding);
+                trace.bound(binding);
+                // ctx is root Context, it can afterResolve
+                ctx->afterResolve();
+                return ptr;
+            };
+        }
+        
+        template <class IFace>
+        std::function<sptr<IFace>(const std::string&)> tryProvider() {
+            // We lock the weak_ptr to our ServiceLocator, the lock returns a shared_ptr which will keep
+            // it alive into the returned lambda via the capture of sl
+            auto sl = getServiceLocator();
+            return [sl] (const std::string& name) {
+                typename TypedServiceLocator<IFace>::shared_ptr_binding* binding = nullptr;
+                auto ctx = makeContext(sl->_resource, sl.get(), std::type_index(typeid(IFace)), name);
+                trace_scope trace(ctx.get());
+                // Don't need to check for recursive resolve since this is a tryProvider (root) call
+                auto ptr = sl->_tryResolve<IFace>(ctx, binding);
+                trace.bound(binding);
+                // ctx is root Context, it can afterResolve
+                ctx->afterResolve();
+                return ptr;
+            };
+        }
+        
+        std::string getResolvePath() const {
+            std::string path = "";
+            // Note the root Parent has a <ServiceLocator> IFace which is not real, just cannot have no interface defined
+            if (_parent != nullptr && _parent->_parent != nullptr) {
+                path = _parent->getResolvePath() + " -> ";
+            }
+            
+            path += "resolve<" + getInterfaceTypeName() + ">(" + _name + ")";
+
+            if (_concreteType != nullptr) {
+                path += ".to<" + getConcreteTypeName() + ">";
+            }
+            
+            return path;
+        }
+        
+        // Queue fnAfterResolve(sptr<Context>) to run once the root resolve has completed
+        template <class Fn>
+        void afterResolve(Fn fnAfterResolve) {
+            _root->_fnAfterResolveList.push_back(after_resolve_fn(std::move(fnAfterResolve)));
+        }
+    };
+    
+    // A resolve of IFace which records the bindings it resolves from, so executing it again goes straight to
+    // them (see compilePlan).  Safe to execute from many threads
+    template <class IFace>
+    class Plan {
+        friend class ServiceLocator;
+        
+    private:
+        struct compiled {
+            std::uint64_t version;
+            Context::plan_steps steps;
+        };
+        
+        sptr<ServiceLocator> _sl;
+        std::string _name;
+        sptr<const compiled> _compiled;
+        
+        Plan(const sptr<ServiceLocator>& sl, const std::string& name) : _sl(sl), _name(name) {
+        }
+        
+    public:
+        // Resolve IFace.  The first execute, and the first after any binding the plan could depend on, records the
+        // resolve as it goes
+        sptr<IFace> execute() {
+            auto current = std::atomic_load(&_compiled);
+            auto version = _sl->chainVersion();
+            
+            Context::plan_cursor cursor = { nullptr, nullptr, 0 };
+            uptr<compiled> recording;
+            if (current != nullptr && current->version == version) {
+                cursor.steps = &current->steps;
+            } else {
+                recording = uptr<compiled>(new compiled());
+                recording->version = version;
+                cursor.recording = &recording->steps;
+            }
+            
+            auto ctx = Context::makeContext(_sl->_resource, _sl.get());
+            ctx->_plan = &cursor;
+            sptr<IFace> ptr;
+            try {
+                ptr = ctx->template resolve<IFace>(_name);
+            } catch (...) {
+                ctx->_plan = nullptr;
+                throw;
+            }
+            ctx->_plan = nullptr;
+            
+            if (recording != nullptr) {
+                std::atomic_store(&_compiled, sptr<const compiled>(std::move(recording)));
+            }
+            return ptr;
+        }
+        
+        sptr<IFace> operator()() {
+            return execute();
+        }
+    };
+    
+    // A handle to an IFace which is resolved the first time it is dereferenced (from any thread), copies share the
+    // one instance.  Keeps the ServiceLocator it resolves from alive (see Context::resolveLazy)
+    template <class IFace>
+    class Lazy {
+        friend class ServiceLocator;
+        friend class Context;
+        
+    private:
+        struct state {
+            // Weak, a Lazy held by a Singleton would otherwise keep the ServiceLocator owning it alive
+            wptr<ServiceLocator> sl;
+            loose_binding* binding;
+            std::string name;
+            sptr<IFace> instance;
+            std::atomic<bool> created;
+            // Recursive so the factory dereferencing this Lazy finds creating set rather than deadlocking
+            std::recursive_mutex createMutex;
+            bool creating;
+            
+            state(const sptr<ServiceLocator>& sl, loose_binding* binding, const std::string& name) : sl(sl), binding(binding), name(name), created(false), creating(false) {
+            }
+        };
+        
+        sptr<state> _state;
+        
+        Lazy(const sptr<ServiceLocator>& sl, loose_binding* binding, const std::string& name) : _state(make_sptr<state>(sl, binding, name)) {
+        }
+        
+    public:
+        Lazy() {
+        }
+        
+        // Throws if the Lazy is empty (default constructed), if its ServiceLocator has been destroyed before the
+        // first dereference, or if dereferenced by the resolve creating it
+        const sptr<IFace>& get() const {
+            if (_state == nullptr) {
+                throw UnableToResolveException("Unable to resolve <" + Context::getTypeName(std::type_index(typeid(IFace))) + ">, the Lazy is empty");
+            }
+            auto& s = *_state;
+            if (!s.created.load(std::memory_order_acquire)) {
+                std::lock_guard<std::recursive_mutex> lock(s.createMutex);
+                if (!s.created.load(std::memory_order_relaxed)) {
+                    auto sl = s.sl.lock();
+                    if (sl == nullptr) {
+                        throw UnableToResolveException("Unable to resolve <" + Context::getTypeName(std::type_index(typeid(IFace))) + ">, the Lazy's ServiceLocator has been destroyed");
+                    }
+                    auto ctx = Context::makeContext(sl->_resource, sl.get(), std::type_index(typeid(IFace)), s.name);
+                    if (s.creating) {
+                        throw RecursiveResolveException("Recursive Lazy resolve path = " + ctx->getResolvePath());
+                    }
+                    // Only the first dereference resolves, later ones just return the instance
+                    trace_scope trace(ctx.get());
+                    trace.bound(s.binding);
+                    s.creating = true;
+                    try {
+                        s.instance = _resolveFrom<IFace>(static_cast<typename TypedServiceLocator<IFace>::shared_ptr_binding*>(s.binding), ctx);
+                        // ctx is root Context, it can afterResolve
+                        ctx->afterResolve();
+                    } catch (...) {
+                        s.creating = false;
+                        throw;
+                    }
+                    s.creating = false;
+                    s.created.store(true, std::memory_order_release);
+                }
+            }
+            return s.instance;
+        }
+        
+        IFace* operator->() const {
+            return get().get();
+        }
+        
+        IFace& operator*() const {
+            return *get();
+        }
+        
+        bool isCreated() const {
+            return _state != nullptr && _state->created.load(std::memory_order_acquire);
+        }
+        
+        // False for a default constructed Lazy
+        explicit operator bool() const {
+            return _state != nullptr;
+        }
+    };
+    
+    // Resolves a named IFace from the binding it last resolved from, the binding is only looked up again after a
+    // new binding which could change the answer (see factory)
+    template <class IFace>
+    class Factory {
+        friend class ServiceLocator;
+        
+    private:
+        sptr<ServiceLocator> _sl;
+        sptr<binding_handle<IFace>> _handle;
+        
+        Factory(const sptr<ServiceLocator>& sl, const std::string& name) : _sl(sl), _handle(make_sptr<binding_handle<IFace>>(name)) {
+        }
+        
+    public:
+        sptr<IFace> operator()() const {
+            // A fresh root Context per call, it holds this resolve's afterResolve list and resolve path and a
+            // Factory may be called from several threads at once, or from within something it resolves
+            auto ctx = Context::makeContext(_sl->_resource, _sl.get(), std::type_index(typeid(IFace)), _handle->getName());
+            trace_scope trace(ctx.get());
+            auto binding = _handle->find(_sl.get());
+            if (binding == nullptr) {
+                throw UnableToResolveException(std::string("Unable to resolve <") + ctx->getInterfaceTypeName() + ">  resolve path = " + ctx->getResolvePath());
+            }
+            trace.bound(binding);
+            auto ptr = _resolveFrom<IFace>(binding, ctx);
+            // ctx is root Context, it can afterResolve
+            ctx->afterResolve();
+            return ptr;
+        }
+    };
+    
+private:
+    class loose_binding {
+    protected:
+        // The ServiceLocator which owns this binding
+        ServiceLocator* _sl;
+        std::string _name;
+        
+        // Orders the bindings seen by resolveAll, lowest first
+        int _priority = 0;
+        
+#ifdef SERVICELOCATOR_COUNT_ALLOCATIONS
+        std::atomic<std::uint64_t> _allocations;
+        std::atomic<std::uint64_t> _allocatedBytes;
+        
+    public:
+        // The binding allocations on this thread are counted against, nullptr when none is resolving
+        static loose_binding*& allocatingBinding() {
+            static thread_local loose_binding* binding = nullptr;
+            return binding;
+        }
+        
+        void countAllocation(std::size_t size) {
+            _allocations.fetch_add(1, std::memory_order_relaxed);
+            _allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        }
+        
+        std::uint64_t getAllocations() const {
+            return _allocations.load(std::memory_order_relaxed);
+        }
+        
+        std::uint64_t getAllocatedBytes() const {
+            return _allocatedBytes.load(std::memory_order_relaxed);
+        }
+        
+        // Counts this thread's allocations against a binding while it resolves, nested resolves count against
+        // their own binding
+        class allocation_scope {
+        private:
+            loose_binding* _previous;
+            
+        public:
+            allocation_scope(loose_binding* binding) : _previous(allocatingBinding()) {
+                allocatingBinding() = binding;
+            }
+            
+            ~allocation_scope() {
+                allocatingBinding() = _previous;
+            }
+        };
+#else
+    public:
+        class allocation_scope {
+        public:
+            allocation_scope(loose_binding*) {
+            }
+        };
+#endif
+        
+#ifdef SERVICELOCATOR_METRICS
+        // Relaxed atomics, a snapshot may be read while resolving continues.  Each thread counts into one of the
+        // shards, summed when read, so threads resolving the same binding don't contend for one cache line
+        struct binding_metrics {
+            // histogram[i] counts constructions taking [2^i, 2^(i + 1)) nanoseconds
+            static const int buckets = 40;
+            static const int shards = 4;
+            
+            struct shard {
+                std::atomic<std::uint64_t> resolves;
+                std::atomic<std::uint64_t> constructions;
+                std::atomic<std::uint64_t> constructionNanos;
+                std::atomic<std::uint64_t> histogram[buckets];
+                // Keeps the next shard's counters off our last cache line
+                char padding[64];
+                
+                shard() : resolves(0), constructions(0), constructionNanos(0) {
+                    for(auto& bucket : histogram) {
+                        bucket.store(0, std::memory_order_relaxed);
+                    }
+                }
+            };
+            shard counters[shards];
+            
+            // Threads are spread over the shards in the order they first count
+            shard& local() {
+                static std::atomic<unsigned> nextShard(0);
+                thread_local unsigned index = nextShard.fetch_add(1, std::memory_order_relaxed) % shards;
+                return counters[index];
+            }
+            
+            std::uint64_t sum(std::atomic<std::uint64_t> shard::* counter) const {
+                std::uint64_t total = 0;
+                for(auto& counter_shard : counters) {
+                    total += (counter_shard.*counter).load(std::memory_order_relaxed);
+                }
+                return total;
+            }
+            
+            std::uint64_t resolves() const {
+                return sum(&shard::resolves);
+            }
+            
+            std::uint64_t constructions() const {
+                return sum(&shard::constructions);
+            }
+            
+            std::uint64_t constructionNanos() const {
+                return sum(&shard::constructionNanos);
+            }
+            
+            std::uint64_t histogram(int bucket) const {
+                std::uint64_t total = 0;
+                for(auto& counter_shard : counters) {
+                    total += counter_shard.histogram[bucket].load(std::memory_order_relaxed);
+                }
+                return total;
+            }
+        };
+        binding_metrics _metrics;
+        
+    public:
+        // A dependency seen resolving from within our resolves, by the interface and name it was resolved as -
+        // not by binding, as a binding in a child locator may be gone by the time the graph is exported
+        struct dependency {
+            std::type_index interfaceType;
+            std::string name;
+            const dependency* next;
+        };
+        
+    private:
+        // Recording stops at this many, as resolving by ever changing names would otherwise grow the list forever
+        static const std::size_t maxDependencies = 64;
+        
+        // Newest first, pushed without a lock and only freed with us.  Resolves only walk the list, see
+        // ServiceLocator::exportGraphDot()
+        std::atomic<const dependency*> _dependencies;
+        
+        // Whether the list from head down to (not including) end holds interfaceType and name, counting the
+        // dependencies walked
+        static bool hasDependency(const dependency* head, const dependency* end, const std::type_index& interfaceType, const std::string& name, std::size_t& count) {
+            for(auto it = head; it != end; it = it->next, count++) {
+                if (it->interfaceType == interfaceType && it->name == name) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        
+    public:
+        typedef std::chrono::steady_clock::time_point metrics_time;
+        
+        static metrics_time metricsNow() {
+            return std::chrono::steady_clock::now();
+        }
+        
+        // n instances handed out by a resolve through slc, which becomes a dependency of the binding resolving
+        // through its parent.  A parent binding slc falls back to finds that binding too, as it resolves through
+        // the same slc
+        void metricsResolved(const sptr<Context>& slc, std::size_t n = 1) {
+            _metrics.local().resolves.fetch_add(n, std::memory_order_relaxed);
+            
+            slc->_binding = this;
+            auto dependant = slc->_retargetedFrom != nullptr ? slc->_retargetedFrom : slc->_parent != nullptr ? slc->_parent->_binding : nullptr;
+            if (dependant != nullptr && dependant != this) {
+                dependant->addDependency(slc->_interfaceType, slc->_name);
+            }
+        }
+        
+        // An existing instance handed out, without a Context of its own, to a resolve from within parent
+        void metricsResolvedExisting(Context* parent) {
+            _metrics.local().resolves.fetch_add(1, std::memory_order_relaxed);
+            
+            auto dependant = parent->_binding;
+            if (dependant != nullptr && dependant != this) {
+                dependant->addDependency(getInterfaceType(), _name);
+            }
+        }
+        
+        void addDependency(const std::type_index& interfaceType, const std::string& name) {
+            auto head = _dependencies.load(std::memory_order_acquire);
+            std::size_t count = 0;
+            if (hasDependency(head, nullptr, interfaceType, name, count) || count >= maxDependencies) {
+                return;
+            }
+            
+            auto added = new dependency { interfaceType, name, head };
+            while(!_dependencies.compare_exchange_weak(added->next, added, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                // Another thread pushed first, it may have pushed the same dependency
+                if (hasDependency(added->next, head, interfaceType, name, count) || count >= maxDependencies) {
+                    delete added;
+                    return;
+                }
+                head = added->next;
+            }
+        }
+        
+        const dependency* getDependencies() const {
+            return _dependencies.load(std::memory_order_acquire);
+        }
+        
+        // n instances constructed since start
+        void metricsConstructed(metrics_time start, std::size_t n = 1) {
+            auto nanos = (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(metricsNow() - start).count();
+            auto& counters = _metrics.local();
+            counters.constructions.fetch_add(n, std::memory_order_relaxed);
+            counters.constructionNanos.fetch_add(nanos, std::memory_order_relaxed);
+            auto each = nanos / n;
+            int bucket = 0;
+            while(bucket < binding_metrics::buckets - 1 && (each >> (bucket + 1)) != 0) {
+                bucket++;
+            }
+            counters.histogram[bucket].fetch_add(n, std::memory_order_relaxed);
+        }
+        
+        const binding_metrics& getMetrics() const {
+            return _metrics;
+        }
+#else
+    public:
+        typedef int metrics_time;
+        
+        static metrics_time metricsNow() {
+            return 0;
+        }
+        
+        void metricsResolved(const sptr<Context>&, std::size_t = 1) {
+        }
+        
+        void metricsResolvedExisting(Context*) {
+        }
+        
+        void metricsConstructed(metrics_time, std::size_t = 1) {
+        }
+#endif
+        
+#ifdef SERVICELOCATOR_COUNT_INSTANCES
+    public:
+        // Shared with the deleters of the instances counted, which may well outlive us
+        struct instance_counts {
+            std::atomic<std::uint64_t> live;
+            std::atomic<std::uint64_t> bytes;
+            std::atomic<std::uint64_t> highWater;
+            
+            instance_counts() : live(0), bytes(0), highWater(0) {
+            }
+            
+            void created(std::size_t size) {
+                auto now = live.fetch_add(1, std::memory_order_relaxed) + 1;
+                bytes.fetch_add(size, std::memory_order_relaxed);
+                auto high = highWater.load(std::memory_order_relaxed);
+                while(now > high && !highWater.compare_exchange_weak(high, now, std::memory_order_relaxed)) {
+                }
+            }
+            
+            void released(std::size_t size) {
+                live.fetch_sub(1, std::memory_order_relaxed);
+                bytes.fetch_sub(size, std::memory_order_relaxed);
+            }
+        };
+        
+        const instance_counts& getInstanceCounts() const {
+            return *_instanceCounts;
+        }
+        
+    protected:
+        sptr<instance_counts> _instanceCounts;
+#endif
+        
+    public:
+        loose_binding(ServiceLocator* sl, const std::string& name) : _sl(sl), _name(name) {
+#ifdef SERVICELOCATOR_METRICS
+            _dependencies.store(nullptr, std::memory_order_relaxed);
+#endif
+#ifdef SERVICELOCATOR_COUNT_ALLOCATIONS
+            _allocations.store(0, std::memory_order_relaxed);
+            _allocatedBytes.store(0, std::memory_order_relaxed);
+#endif
+#ifdef SERVICELOCATOR_COUNT_INSTANCES
+            _instanceCounts = make_sptr<instance_counts>();
+#endif
+        }
+        
+        virtual ~loose_binding() {
+#ifdef SERVICELOCATOR_METRICS
+            auto it = _dependencies.load(std::memory_order_relaxed);
+            while(it != nullptr) {
+                auto next = it->next;
+                delete it;
+                it = next;
+            }
+#endif
+        }
+        
+        ServiceLocator* getServiceLocator() const {
+            return _sl;
+        }
+        
+        const std::string& getName() const {
+            return _name;
+        }
+        
+        int getPriority() const {
+            return _priority;
+        }
+        
+        void setPriority(int priority) {
+            _priority = priority;
+            // resolveAll's merged view of the bindings is stale
+            _sl->bindingsChanged();
+        }
+        
+        virtual std::type_index getInterfaceType() const = 0;
+        virtual Lifetime getLifetime() const = 0;
+        
+        // The binding an alias resolves from sl, nullptr when we are not an alias
+        virtual loose_binding* aliasTarget(ServiceLocator* sl) = 0;
+        
+        virtual void eagerBind(const sptr<Context>& slc) = 0;
+        
+        // Drop the Singleton instance held by the binding
+        virtual void releaseInstance() = 0;
+    };
+    
+    class AnyServiceLocator {
+    public:
+        virtual ~AnyServiceLocator() {
+        }
+        
+        // Drop anything cached which holds onto instances
+        virtual void releaseCaches() = 0;
+        
+        virtual void forEachBinding(const std::function<void(loose_binding*)>& fn) = 0;
     };
     
     template <class IFace>
@@ -337,11 +1862,89 @@ private:
     public:
         class shared_ptr_binding : public loose_binding {
         private:
-            std::function<sptr<IFace>(sptr<Context>)> _fnGet;
-            std::function<sptr<IFace>(sptr<Context>)> _fnCreate;
+            typedef inline_function<sptr<IFace>(const sptr<Context>&)> create_fn;
+            typedef inline_function<uptr<IFace>(const sptr<Context>&)> create_unique_fn;
+            
+            create_fn _fnCreate;
+            
+            // Creates instances for resolveUnique, only set when the factory can hand over sole ownership
+            create_unique_fn _fnCreateUnique;
+            
+            // Creates n transient instances sharing 1 allocation, only set by the built in factories
+            typedef inline_function<void(const sptr<Context>&, std::size_t, std::vector<sptr<IFace>>*)> create_many_fn;
+            create_many_fn _fnCreateMany;
+            
+            // An alias's instances are counted by the binding it aliases
+            bool _alias = false;
+            inline_function<loose_binding*(ServiceLocator*)> _fnAliasTarget;
+            Lifetime _lifetime = Lifetime::Transient;
+            
+            // The Singleton once created or the bound Instance, _created publishes it to other threads so once set
+            // resolving it takes no lock
+            sptr<IFace> _instance;
+            std::atomic<bool> _created;
+            std::mutex _createMutex;
+            
+#ifdef SERVICELOCATOR_COUNT_INSTANCES
+            // Releases the instance it wraps, counting it as released
+            struct counted_release {
+                sptr<IFace> instance;
+                sptr<instance_counts> counts;
+                std::size_t size;
+                
+                void operator()(IFace*) {
+                    instance.reset();
+                    counts->released(size);
+                }
+            };
+            
+            // ptr as an sptr whose deleter counts it as released, size is the concrete type's (when known)
+            sptr<IFace> countInstance(sptr<IFace> ptr, std::size_t size) {
+                if (ptr == nullptr || _alias) {
+                    return ptr;
+                }
+                _instanceCounts->created(size);
+                auto instance = ptr.get();
+                return sptr<IFace>(instance, counted_release { std::move(ptr), _instanceCounts, size });
+            }
+#else
+            sptr<IFace> countInstance(sptr<IFace> ptr, std::size_t) {
+                return ptr;
+            }
+#endif
+            
+            // ptr, or when it is nullptr what our ServiceLocator's parent resolves slc to
+            sptr<IFace> orParent(sptr<IFace> ptr, const sptr<Context>& slc) {
+                if (ptr != nullptr) {
+                    return ptr;
+                }
+                if (_sl->_parent == nullptr) {
+                    throw UnableToResolveException(std::string("Unable to resolve <") + slc->getInterfaceTypeName() + ">  resolve path = " + slc->getResolvePath());
+                }
+                return _sl->_parent->_resolve<IFace>(slc);
+            }
             
-            // Note, this is used during binding only ..
-            std::list<loose_binding*>* _eagerBindings;
+            const sptr<IFace>& singleton(const sptr<Context>& slc) {
+                if (slc->_dependant != nullptr) {
+                    slc->_dependant->getServiceLocator()->singletonDependency(slc->_dependant, this);
+                }
+                if (!_created.load(std::memory_order_acquire)) {
+                    std::lock_guard<std::mutex> lock(_createMutex);
+                    if (!_created.load(std::memory_order_relaxed)) {
+                        slc->_dependant = this;
+                        auto start = metricsNow();
+                        trace_scope trace(slc.get(), Lifetime::Singleton);
+                        startup_scope profile(this);
+                        auto instance = _fnCreate(slc);
+                        // The factory sets the concrete size
+                        _instance = countInstance(std::move(instance), slc->_concreteSize);
+                        metricsConstructed(start);
+                        _created.store(true, std::memory_order_release);
+                        _sl->singletonCreated(this);
+                    }
+                }
+                return _instance;
+            }
 
         public:
             class eagerly_clause {
@@ -353,38 +1956,49 @@ private:
                 }
                 
                 void eagerly() {
-                    _ibinding->_eagerBindings->push_back(_ibinding);
+                    _ibinding->_sl->_eagerBindings.push_back(_ibinding);
+                    _ibinding->_sl->_eagerPending.store(true, std::memory_order_release);
                 }
             };
             
             class as_clause {
             private:
-                sptr<IFace> _singleton;
                 shared_ptr_binding* _ibinding;
                 
             public:
                 as_clause(shared_ptr_binding* ibinding) : _ibinding(ibinding) {
                 }
                 
+                // on 1st resolve we create the singleton, after that it is returned as is
                 eagerly_clause& asSingleton() {
-                    // on 1st call we create the singleton ..
-                    _ibinding->_fnGet = [this] (sptr<Context> slc) {
-                        _singleton = _ibinding->_fnCreate(slc);
-                        
-                        auto singleton = _singleton;
-                        
-                        // rebind fnGet to return the new singleton
-                        _ibinding->_fnGet = [this] (sptr<Context> slc) {
-                            return _singleton;
-                        };
-                        
-                        return singleton;
-                    };
+                    _ibinding->_lifetime = Lifetime::Singleton;
                     return _ibinding->_eagerly_clause;
                 }
 
                 void asTransient() {
-                    _ibinding->_fnGet = _ibinding->_fnCreate;
+                    _ibinding->_lifetime = Lifetime::Transient;
+                }
+                
+                // resolveAll returns bindings in priority order, lowest first.  Bindings of equal priority keep
+                // the order of their ServiceLocators (child first) then their names
+                as_clause& priority(int priority) {
+                    _ibinding->setPriority(priority);
+                    return *this;
+                }
+            };
+            
+            // An Instance binding's lifetime is fixed, only its priority can be set
+            class instance_clause {
+            private:
+                shared_ptr_binding* _ibinding;
+                
+            public:
+                instance_clause(shared_ptr_binding* ibinding) : _ibinding(ibinding) {
+                }
+                
+                // As as_clause::priority
+                void priority(int priority) {
+                    _ibinding->setPriority(priority);
                 }
             };
 
@@ -392,100 +2006,238 @@ private:
             private:
                 shared_ptr_binding* _ibinding;
                 
+                // uptr<IFace> can only delete a TImpl through a virtual destructor, without one resolveUnique
+                // reports a BindingIssueException rather than risk slicing the delete
+                template <class TImpl>
+                using can_delete_as_iface = std::integral_constant<bool, std::is_same<typename std::remove_cv<IFace>::type, TImpl>::value || std::has_virtual_destructor<IFace>::value>;
+                
+                template <class TImpl, class Fn>
+                void setCreateUnique(Fn fnCreateUnique) {
+                    setCreateUnique(std::move(fnCreateUnique), can_delete_as_iface<TImpl>());
+                }
+                
+                template <class Fn>
+                void setCreateUnique(Fn fnCreateUnique, std::true_type) {
+                    _ibinding->_fnCreateUnique = create_unique_fn(std::move(fnCreateUnique));
+                }
+                
+                template <class Fn>
+                void setCreateUnique(Fn, std::false_type) {
+                    _ibinding->_fnCreateUnique = nullptr;
+                }
+                
+                // User factories may return sptr<TImpl> or TImpl*
+                template <class TImpl, class Fn, class TResult>
+                as_clause& toFactory(Fn fnCreate, sptr<TResult>*) {
+                    _ibinding->_fnCreate = [fnCreate] (const sptr<Context>& slc) {
+                        slc->setConcreteType<TImpl>();
+                        return sptr<TImpl>(fnCreate(slc));
+                    };
+                    _ibinding->_fnCreateUnique = nullptr;
+                    return _ibinding->_as_clause;
+                }
+                
+                template <class TImpl, class Fn, class TResult>
+                as_clause& toFactory(Fn fnCreate, TResult**) {
+                    _ibinding->_fnCreate = [fnCreate] (const sptr<Context>& slc) {
+                        slc->setConcreteType<TImpl>();
+                        // create sptr around the returned ptr
+                        TImpl* ptr = fnCreate(slc);
+                        return sptr<TImpl>(ptr);
+                    };
+                    setCreateUnique<TImpl>([fnCreate] (const sptr<Context>& slc) {
+                        slc->setConcreteType<TImpl>();
+                        TImpl* ptr = fnCreate(slc);
+                        return uptr<IFace>(ptr);
+                    });
+                    return _ibinding->_as_clause;
+                }
+                
             public:
                 to_clause(shared_ptr_binding* ibinding) : _ibinding(ibinding) {
                 }
                 
-                void toInstance(sptr<IFace> instance) {
+                instance_clause& toInstance(sptr<IFace> instance) {
                     // fnCreate is not needed, we always return 'instance'
-                    _ibinding->_fnGet = [instance] (sptr<Context> slc) {
-                        return instance;
-                    };
+                    _ibinding->_lifetime = Lifetime::Instance;
+                    _ibinding->_instance = instance;
+                    return _ibinding->_instance_clause;
                 }
 
-                void toInstance(IFace* instance) {
-                    auto cached = sptr<IFace>(instance);
-                    // fnCreate is not needed, we always return 'instance'
-                    _ibinding->_fnGet = [cached] (sptr<Context> slc) {
-                        return cached;
-                    };
+                instance_clause& toInstance(IFace* instance) {
+                    return toInstance(sptr<IFace>(instance));
                 }
 
                 as_clause& toSelf() {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [] (sptr<Context> slc) {
-                        slc->setConcreteType(std::type_index(typeid(IFace)));
-                        return sptr<IFace>(new IFace(slc));
+                    auto resource = _ibinding->_sl->_instanceResource;
+                    _ibinding->_fnCreate = [resource] (const sptr<Context>& slc) {
+                        slc->setConcreteType<IFace>();
+                        return makeInstance<IFace>(resource, slc);
+                    };
+                    setCreateUnique<IFace>([] (const sptr<Context>& slc) {
+                        slc->setConcreteType<IFace>();
+                        return newUnique<IFace, IFace>(slc);
+                    });
+                    _ibinding->_fnCreateMany = [resource] (const sptr<Context>& slc, std::size_t n, std::vector<sptr<IFace>>* out) {
+                        slc->setConcreteType<IFace>();
+                        makeInstances<IFace>(resource, n, out, slc);
                     };
                     return _ibinding->_as_clause;
                 }
                 
+                // fnCreate(sptr<Context>) returns sptr<IFace> or IFace*
+                template <class Fn>
+                as_clause& toSelf(Fn fnCreate) {
+                    return to<IFace>(std::move(fnCreate));
+                }
+
                 as_clause& toSelfNoDependancy() {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [] (sptr<Context> slc) {
-                        slc->setConcreteType(std::type_index(typeid(IFace)));
-                        return sptr<IFace>(new IFace());
+                    auto resource = _ibinding->_sl->_instanceResource;
+                    _ibinding->_fnCreate = [resource] (const sptr<Context>& slc) {
+                        slc->setConcreteType<IFace>();
+                        return makeInstance<IFace>(resource);
+                    };
+                    setCreateUnique<IFace>([] (const sptr<Context>& slc) {
+                        slc->setConcreteType<IFace>();
+                        return newUnique<IFace, IFace>();
+                    });
+                    _ibinding->_fnCreateMany = [resource] (const sptr<Context>& slc, std::size_t n, std::vector<sptr<IFace>>* out) {
+                        slc->setConcreteType<IFace>();
+                        makeInstances<IFace>(resource, n, out);
                     };
                     return _ibinding->_as_clause;
                 }
                 
                 template <class TImpl>
                 as_clause& to() {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [] (sptr<Context> slc) {
-                        slc->setConcreteType(std::type_index(typeid(TImpl)));
-                        return sptr<TImpl>(new TImpl(slc));
+                    auto resource = _ibinding->_sl->_instanceResource;
+                    _ibinding->_fnCreate = [resource] (const sptr<Context>& slc) {
+                        slc->setConcreteType<TImpl>();
+                        return makeInstance<TImpl>(resource, slc);
+                    };
+                    setCreateUnique<TImpl>([] (const sptr<Context>& slc) {
+                        slc->setConcreteType<TImpl>();
+                        return newUnique<IFace, TImpl>(slc);
+                    });
+                    _ibinding->_fnCreateMany = [resource] (const sptr<Context>& slc, std::size_t n, std::vector<sptr<IFace>>* out) {
+                        slc->setConcreteType<TImpl>();
+                        makeInstances<TImpl>(resource, n, out, slc);
                     };
                     return _ibinding->_as_clause;
                 }
                 
                 template <class TImpl>
                 as_clause& toNoDependancy() {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [] (sptr<Context> slc) {
-                        slc->setConcreteType(std::type_index(typeid(TImpl)));
-                        return sptr<TImpl>(new TImpl());
+                    auto resource = _ibinding->_sl->_instanceResource;
+                    _ibinding->_fnCreate = [resource] (const sptr<Context>& slc) {
+                        slc->setConcreteType<TImpl>();
+                        return makeInstance<TImpl>(resource);
+                    };
+                    setCreateUnique<TImpl>([] (const sptr<Context>& slc) {
+                        slc->setConcreteType<TImpl>();
+                        return newUnique<IFace, TImpl>();
+                    });
+                    _ibinding->_fnCreateMany = [resource] (const sptr<Context>& slc, std::size_t n, std::vector<sptr<IFace>>* out) {
+                        slc->setConcreteType<TImpl>();
+                        makeInstances<TImpl>(resource, n, out);
                     };
                     return _ibinding->_as_clause;
                 }
                 
-                template <class TImpl>
-                as_clause& to(std::function<sptr<TImpl>(sptr<Context>)> fnCreate) {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [fnCreate] (sptr<Context> slc) {
-                        slc->setConcreteType(std::type_index(typeid(TImpl)));
-                        return fnCreate(slc);
+                // fnCreate(sptr<Context>) returns sptr<TImpl> or TImpl*, only a TImpl* factory can also be used by
+                // resolveUnique.  Prefer returning make_sptr<TImpl>(...) over new TImpl(...), the instance and its
+                // reference count are then allocated together.  fnCreate may take const sptr<Context>& to save
+                // copying the Context pointer
+                template <class TImpl, class Fn>
+                as_clause& to(Fn fnCreate) {
+                    typedef typename std::result_of<Fn&(const sptr<Context>&)>::type result_type;
+                    return toFactory<TImpl>(std::move(fnCreate), static_cast<result_type*>(nullptr));
+                }
+                
+                // Factory handing over sole ownership, instances can be resolved with resolveUnique as well as resolve
+                template <class TImpl, class Fn>
+                as_clause& toUnique(Fn fnCreate) {
+                    static_assert(can_delete_as_iface<TImpl>::value, "toUnique<TImpl> requires IFace to have a virtual destructor");
+                    _ibinding->_fnCreate = [fnCreate] (const sptr<Context>& slc) {
+                        slc->setConcreteType<TImpl>();
+                        return sptr<TImpl>(fnCreate(slc));
+                    };
+                    _ibinding->_fnCreateUnique = [fnCreate] (const sptr<Context>& slc) {
+                        slc->setConcreteType<TImpl>();
+                        return uptr<IFace>(fnCreate(slc));
                     };
                     return _ibinding->_as_clause;
                 }
-
-                // similar to above, except caller can return IFace* instead of sptr<IFace>
-                template <class TImpl>
-                as_clause& to(std::function<TImpl*(sptr<Context>)> fnCreate) {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [fnCreate] (sptr<Context> slc) {
-                        slc->setConcreteType(std::type_index(typeid(TImpl)));
-                        // create sptr around the returned ptr
-                        auto ptr = fnCreate(slc);
-                        return sptr<TImpl>(ptr);
+                
+                // Construct TImpl(TArgs...) resolving each constructor argument, eg
+                //
+                // bind<IFoo>().toAutowired<Foo, sptr<IBar>, uptr<IBaz>>();
+                //
+                // sptr<IFace> arguments are resolved, uptr<IFace> arguments resolved with resolveUnique and Lazy<IFace>
+                // arguments with resolveLazy.  Each argument keeps a handle to the binding it resolved to, so later
+                // constructions skip the binding lookup
+                template <class TImpl, class... TArgs>
+                as_clause& toAutowired() {
+                    typedef std::tuple<autowire_arg<TArgs>...> autowire_args;
+                    auto args = sptr<autowire_args>(new autowire_args());
+                    auto resource = _ibinding->_sl->_instanceResource;
+                    _ibinding->_fnCreate = [args, resource] (const sptr<Context>& slc) {
+                        slc->setConcreteType<TImpl>();
+                        return autowire(*args, slc, typename make_indices<sizeof...(TArgs)>::type(), [resource] (typename autowire_arg<TArgs>::type&&... resolved) {
+                            return makeInstance<TImpl>(resource, std::move(resolved)...);
+                        });
                     };
+                    setCreateUnique<TImpl>([args] (const sptr<Context>& slc) {
+                        slc->setConcreteType<TImpl>();
+                        return autowire(*args, slc, typename make_indices<sizeof...(TArgs)>::type(), [] (typename autowire_arg<TArgs>::type&&... resolved) {
+                            return newUnique<IFace, TImpl>(std::move(resolved)...);
+                        });
+                    });
                     return _ibinding->_as_clause;
                 }
                 
+                // Autowire to IFace itself
+                template <class... TArgs>
+                as_clause& toSelfAutowired() {
+                    return toAutowired<IFace, TArgs...>();
+                }
+                
                 as_clause& alias(const std::string& name) {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [name] (sptr<Context> slc) {
-                        return slc->resolve<IFace>(name);
-                    };
-                    return _ibinding->_as_clause;
+                    return alias<IFace>(name);
                 }
 
                 template <class IAlias>
                 as_clause& alias() {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [] (sptr<Context> slc) {
-                        return slc->resolve<IAlias>(slc->getName());
-                    };
-                    return _ibinding->_as_clause;
+                    return alias<IAlias>(_ibinding->getName());
                 }
                 
+                // An alias resolves the binding it aliases as resolve<IAlias>(name) would, but in place of itself in
+                // its own Context (see Context::retarget_scope) rather than allocating another, and only looks that
+                // binding up again once a new binding could change it.  The resolve path and parent fallback are
+                // those of resolve<IAlias>(name), the alias itself doesn't appear in the path
                 template <class IAlias>
                 as_clause& alias(const std::string& name) {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [name] (sptr<Context> slc) {
-                        return slc->resolve<IAlias>(name);
+                    auto handle = make_sptr<binding_handle<IAlias>>(name);
+                    auto alias = _ibinding;
+                    _ibinding->_fnCreate = [handle, alias] (const sptr<Context>& slc) -> sptr<IFace> {
+                        trace_scope trace(slc.get(), std::type_index(typeid(IAlias)), handle->getName());
+                        auto binding = handle->find(slc->_sl);
+                        // Checked before retargeting, so the path names the alias that failed
+                        if (binding == nullptr) {
+                            throw UnableToResolveException(std::string("Unable to resolve alias <") + Context::getTypeName(std::type_index(typeid(IAlias))) + "> named " + handle->getName() + "  resolve path = " + slc->getResolvePath());
+                        }
+                        _checkAliasCycle(alias, binding, slc->_sl, slc.get());
+                        trace.bound(binding);
+                        typename Context::retarget_scope retarget(slc.get(), std::type_index(typeid(IAlias)), handle->getName());
+                        if (slc->_parent != nullptr) {
+                            slc->checkRecursiveResolve(slc.get(), slc->_parent);
+                        }
+                        return _resolveFrom<IAlias>(binding, slc);
+                    };
+                    _ibinding->_fnAliasTarget = [handle] (ServiceLocator* sl) -> loose_binding* {
+                        return handle->find(sl);
                     };
+                    _ibinding->_alias = true;
                     return _ibinding->_as_clause;
                 }
 
@@ -493,39 +2245,196 @@ private:
         
             to_clause _to_clause;
             as_clause _as_clause;
+            instance_clause _instance_clause;
             eagerly_clause _eagerly_clause;
             
         public:
-            shared_ptr_binding(std::list<loose_binding*>* eagerBindings)
+            shared_ptr_binding(ServiceLocator* sl, const std::string& name)
                 :
-                _eagerBindings(eagerBindings),
+                loose_binding(sl, name),
+                _created(false),
                 _to_clause(this),
                 _as_clause(this),
+                _instance_clause(this),
                 _eagerly_clause(this) {
             }
             
-            virtual sptr<IFace> get(sptr<Context> slc) const {
-                return _fnGet(slc);
+            std::type_index getInterfaceType() const override {
+                return std::type_index(typeid(IFace));
+            }
+            
+            Lifetime getLifetime() const override {
+                return _lifetime;
+            }
+            
+            loose_binding* aliasTarget(ServiceLocator* sl) override {
+                return _alias ? _fnAliasTarget(sl) : nullptr;
+            }
+            
+            sptr<IFace> get(const sptr<Context>& slc) {
+                allocation_scope scope(this);
+                metricsResolved(slc);
+                switch(_lifetime) {
+                    case Lifetime::Singleton:
+                        return singleton(slc);
+                    case Lifetime::Instance:
+                        return _instance;
+                    default: {
+                        auto start = metricsNow();
+                        trace_scope trace(slc.get(), Lifetime::Transient);
+                        startup_scope profile(this);
+                        auto ptr = _fnCreate(slc);
+                        ptr = countInstance(std::move(ptr), slc->_concreteSize);
+                        metricsConstructed(start);
+                        return ptr;
+                    }
+                }
+            }
+            
+            IFace& getRef(const sptr<Context>& slc) {
+                if (_lifetime == Lifetime::Transient) {
+                    throw BindingIssueException("resolveRef<" + slc->getInterfaceTypeName() + "> requires a Singleton or Instance binding, resolve path = " + slc->getResolvePath());
+                }
+                allocation_scope scope(this);
+                metricsResolved(slc);
+                auto& ptr = _lifetime == Lifetime::Singleton ? singleton(slc) : _instance;
+                if (ptr == nullptr) {
+                    throw UnableToResolveException("resolveRef<" + slc->getInterfaceTypeName() + "> binding has a null instance, resolve path = " + slc->getResolvePath());
+                }
+                return *ptr;
+            }
+            
+            // The Instance, or the Singleton once created, nullptr otherwise
+            const sptr<IFace>* existingInstance() const {
+                if (_lifetime == Lifetime::Instance || (_lifetime == Lifetime::Singleton && _created.load(std::memory_order_acquire))) {
+                    return &_instance;
+                }
+                return nullptr;
+            }
+            
+            // Append n instances to out, 1 shared instance n times when not transient.  An instance resolving to
+            // nullptr falls back to our ServiceLocator's parent, as a resolve does
+            void getMany(const sptr<Context>& slc, std::size_t n, std::vector<sptr<IFace>>* out, bool sharedAllocation) {
+                allocation_scope scope(this);
+                if (_lifetime != Lifetime::Transient) {
+                    out->insert(out->end(), n, orParent(get(slc), slc));
+                    // get counted 1 of them
+                    if (n > 1) {
+                        metricsResolved(slc, n - 1);
+                    }
+                    return;
+                }
+                metricsResolved(slc, n);
+                auto start = metricsNow();
+                trace_scope trace(slc.get(), Lifetime::Transient);
+                startup_scope profile(this);
+                if (sharedAllocation && _fnCreateMany) {
+#ifdef SERVICELOCATOR_COUNT_INSTANCES
+                    auto first = out->size();
+                    _fnCreateMany(slc, n, out);
+                    for(auto i = first; i < out->size(); i++) {
+                        (*out)[i] = countInstance(std::move((*out)[i]), slc->_concreteSize);
+                    }
+#else
+                    _fnCreateMany(slc, n, out);
+#endif
+                } else {
+                    for(std::size_t i = 0; i < n; i++) {
+                        // Every instance is created from the same Context
+                        slc->_concreteType.reset();
+                        slc->_concreteTypeName.reset();
+                        auto ptr = _fnCreate(slc);
+                        if (ptr == nullptr) {
+                            slc->_concreteType.reset();
+                            slc->_concreteTypeName.reset();
+                            out->push_back(orParent(nullptr, slc));
+                        } else {
+                            out->push_back(countInstance(std::move(ptr), slc->_concreteSize));
+                        }
+                    }
+                }
+                if (n > 0) {
+                    metricsConstructed(start, n);
+                }
+            }
+            
+            uptr<IFace> getUnique(const sptr<Context>& slc) const {
+                if (_lifetime != Lifetime::Transient) {
+                    throw BindingIssueException("resolveUnique<" + slc->getInterfaceTypeName() + "> requires a transient binding, resolve path = " + slc->getResolvePath());
+                }
+                if (!_fnCreateUnique) {
+                    throw BindingIssueException("resolveUnique<" + slc->getInterfaceTypeName() + "> binding cannot create unique instances, resolve path = " + slc->getResolvePath());
+                }
+                auto self = const_cast<shared_ptr_binding*>(this);
+                allocation_scope scope(self);
+                self->metricsResolved(slc);
+                auto start = metricsNow();
+                trace_scope trace(slc.get(), Lifetime::Transient);
+                startup_scope profile(this);
+                auto ptr = _fnCreateUnique(slc);
+                self->metricsConstructed(start);
+                return ptr;
+            }
+            
+            void eagerBind(const sptr<Context>& slc) override {
+                auto ctx = Context::makeContext(_sl->_resource, slc.get(), std::type_index(typeid(IFace)), "");
+                get(ctx);
             }
             
-            void eagerBind(sptr<Context> slc) override {
-                auto ctx = sptr<Context>(new Context(slc.get(), std::type_index(typeid(IFace)), ""));
-                _fnGet(ctx);
+            void releaseInstance() override {
+                sptr<IFace> instance;
+                {
+                    std::lock_guard<std::mutex> lock(_createMutex);
+                    instance.swap(_instance);
+                    _created.store(false, std::memory_order_release);
+                }
+                // instance is released outside of the lock, its destructor may well resolve
             }
         };
         
-        std::map<std::string, sptr<loose_binding>> _bindings;
+        typedef std::pair<const std::string, sptr<loose_binding>> binding_entry;
+        typedef std::map<std::string, sptr<loose_binding>, std::less<std::string>, Allocator<binding_entry>> binding_map;
+        binding_map _bindings;
+        
+        // resolveAllShared's cached result, only kept while every binding is a Singleton or Instance
+        struct all_snapshot {
+            std::uint64_t version;
+            std::vector<sptr<IFace>> all;
+        };
+        sptr<const all_snapshot> _allSnapshot;
+        
+        // The bindings resolveAll visits from the ServiceLocator owning us: ours then our parents', each name
+        // once (a child's binding overrides its parent's) in priority order.  Rebuilt once a new binding could
+        // change it
+        struct merged_view {
+            std::uint64_t version;
+            std::vector<shared_ptr_binding*> bindings;
+        };
+        sptr<const merged_view> _mergedView;
+        
+        void releaseCaches() override {
+            std::atomic_store(&_allSnapshot, sptr<const all_snapshot>());
+        }
+        
+        void forEachBinding(const std::function<void(loose_binding*)>& fn) override {
+            for(auto& binding : _bindings) {
+                fn(binding.second.get());
+            }
+        }
 
     public:
-        typename shared_ptr_binding::to_clause& bind(const std::string& name, std::list<loose_binding*>* eagerBindings) {
+        TypedServiceLocator(MemoryResource* resource) : _bindings(Allocator<binding_entry>(resource)) {
+        }
+        
+        typename shared_ptr_binding::to_clause& bind(const std::string& name, ServiceLocator* sl) {
             if (canResolve(name)) {
                 throw DuplicateBindingException(std::string("Duplicate binding for <") + typeid(IFace).name() + "> named " + name);
             }
 
-            auto binding = sptr<shared_ptr_binding>(new shared_ptr_binding(eagerBindings));
+            auto binding = allocate_sptr<shared_ptr_binding>(Allocator<shared_ptr_binding>(sl->_resource), sl, name);
             
             // (non const) IFace binding
-            _bindings.insert(std::pair<std::string, sptr<loose_binding>>(name, binding));
+            _bindings.insert(binding_entry(name, binding));
             
             return binding->_to_clause;
         }
@@ -533,28 +2442,262 @@ private:
         bool canResolve(const std::string& name) {
             return _bindings.find(name) != _bindings.end();
         }
-
-        sptr<IFace> tryResolve(const std::string& name, sptr<Context> slc) {
-            auto binding = _bindings.find(name);
-            if (binding == _bindings.end()) {
-                return nullptr;
-            }
-            auto ibinding = std::dynamic_pointer_cast<shared_ptr_binding>(binding->second);
-            
-            return ibinding->get(slc);
+        
+        shared_ptr_binding* find(const std::string& name) {
+            auto binding = _bindings.find(name);
+            if (binding == _bindings.end()) {
+                return nullptr;
+            }
+            return static_cast<shared_ptr_binding*>(binding->second.get());
+        }
+
+        sptr<IFace> tryResolve(const std::string& name, const sptr<Context>& slc, shared_ptr_binding*& resolvedBy) {
+            auto binding = find(name);
+            if (binding == nullptr) {
+                return nullptr;
+            }
+            resolvedBy = binding;
+            return binding->get(slc);
+        }
+    };
+    
+public:
+    // The bindings of IFace from a Context's ServiceLocator then its parents, see Context::resolveAllRange
+    template <class IFace>
+    class ResolveAllRange {
+        friend class Context;
+        
+    private:
+        typedef typename TypedServiceLocator<IFace>::merged_view merged_view;
+        typedef typename TypedServiceLocator<IFace>::shared_ptr_binding binding_type;
+        
+    public:
+        class iterator {
+            friend class ServiceLocator;
+            friend class ResolveAllRange;
+            friend class Context;
+            
+        private:
+            Context* _slc;
+            const binding_type* const* _it;
+            
+            iterator(Context* slc, const binding_type* const* it) : _slc(slc), _it(it) {
+            }
+            
+            binding_type* binding() const {
+                return const_cast<binding_type*>(*_it);
+            }
+            
+            // Resolves the binding, leaving afterResolve to the caller
+            sptr<IFace> resolve() const {
+                auto binding = this->binding();
+                trace_scope trace(_slc, std::type_index(typeid(IFace)), binding->getName());
+                trace.bound(binding);
+                // An already created Singleton (or an Instance) needs no Context, unless we are constructing a
+                // Singleton which must record it as a dependency
+                if (_slc->_dependant == nullptr) {
+                    const sptr<IFace>* instance = binding->existingInstance();
+                    if (instance != nullptr) {
+                        binding->metricsResolvedExisting(_slc);
+                        return *instance;
+                    }
+                }
+                auto ctx = Context::makeContext(_slc->_resource, _slc, std::type_index(typeid(IFace)), binding->getName());
+                _slc->checkRecursiveResolve(ctx.get(), _slc);
+                return binding->get(ctx);
+            }
+            
+        public:
+            sptr<IFace> operator*() const {
+                auto ptr = resolve();
+                _slc->afterResolve();
+                return ptr;
+            }
+            
+            iterator& operator++() {
+                ++_it;
+                return *this;
+            }
+            
+            bool operator==(const iterator& other) const {
+                return _it == other._it;
+            }
+            
+            bool operator!=(const iterator& other) const {
+                return !(*this == other);
+            }
+        };
+        
+    private:
+        Context* _slc;
+        // Keeps the bindings we iterate, nullptr when there are none
+        sptr<const merged_view> _view;
+        
+        ResolveAllRange(Context* slc) : _slc(slc), _view(slc->_sl->template _mergedBindings<IFace>()) {
+        }
+        
+    public:
+        iterator begin() const {
+            return iterator(_slc, _view != nullptr ? _view->bindings.data() : nullptr);
+        }
+        
+        iterator end() const {
+            return iterator(_slc, _view != nullptr ? _view->bindings.data() + _view->bindings.size() : nullptr);
+        }
+    };
+    
+private:
+    // Caches the binding a named IFace resolves to from a given ServiceLocator.  Asked again by the same locator
+    // while no binding has been made anywhere (see bindEpoch) the cached binding is returned without any lookup.
+    // Otherwise, locators below the nearest one with bindings of IFace all resolve it the same, so the entry is
+    // also keyed on that locator's id and the binding version of it and its parents - per request child locators
+    // only walk up to it, skipping the binding lookup, and any new binding which could change the answer forces
+    // a fresh lookup.  Readers take no lock (the entry is a seqlock), and a lookup racing another thread's update
+    // just isn't cached
+    template <class IFace>
+    class binding_handle {
+    private:
+        typedef typename TypedServiceLocator<IFace>::shared_ptr_binding binding_type;
+        
+        std::string _name;
+        std::atomic<unsigned> _sequence;
+        std::atomic<std::uint64_t> _requesterId;
+        std::atomic<std::uint64_t> _epoch;
+        std::atomic<std::uint64_t> _locatorId;
+        std::atomic<std::uint64_t> _version;
+        std::atomic<binding_type*> _binding;
+        std::mutex _updateMutex;
+        
+    public:
+        binding_handle(const std::string& name = "") : _name(name), _sequence(0), _requesterId(0), _epoch(0), _locatorId(0), _version(0), _binding(nullptr) {
+        }
+        
+        const std::string& getName() const {
+            return _name;
+        }
+        
+        // The binding resolving from sl finds, nullptr if there is none
+        binding_type* find(ServiceLocator* sl) {
+            // Read before anything it guards, a binding made meanwhile leaves our entry stale rather than wrong
+            auto epoch = bindEpoch().load(std::memory_order_acquire);
+            auto sequence = _sequence.load(std::memory_order_acquire);
+            auto requesterId = _requesterId.load(std::memory_order_relaxed);
+            auto cachedEpoch = _epoch.load(std::memory_order_relaxed);
+            auto locatorId = _locatorId.load(std::memory_order_relaxed);
+            auto cachedVersion = _version.load(std::memory_order_relaxed);
+            auto binding = _binding.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            auto cached = (sequence & 1) == 0 && _sequence.load(std::memory_order_relaxed) == sequence && binding != nullptr;
+            if (cached && requesterId == sl->_id && cachedEpoch == epoch) {
+                return binding;
+            }
+            
+            ServiceLocator* owner;
+            if (sl->_nearestTypedServiceLocator<IFace>(owner) == nullptr) {
+                return nullptr;
+            }
+            auto version = owner->chainVersion();
+            if (!cached || locatorId != owner->_id || cachedVersion != version) {
+                binding = owner->_findBinding<IFace>(_name);
+            }
+            if (binding != nullptr) {
+                std::unique_lock<std::mutex> lock(_updateMutex, std::try_to_lock);
+                if (lock.owns_lock()) {
+                    sequence = _sequence.load(std::memory_order_relaxed);
+                    _sequence.store(sequence + 1, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_release);
+                    _requesterId.store(sl->_id, std::memory_order_relaxed);
+                    _epoch.store(epoch, std::memory_order_relaxed);
+                    _locatorId.store(owner->_id, std::memory_order_relaxed);
+                    _version.store(version, std::memory_order_relaxed);
+                    _binding.store(binding, std::memory_order_relaxed);
+                    _sequence.store(sequence + 2, std::memory_order_release);
+                }
+            }
+            return binding;
+        }
+    };
+    
+    template <std::size_t... I>
+    struct indices {
+    };
+    
+    template <std::size_t N, std::size_t... I>
+    struct make_indices : make_indices<N - 1, N - 1, I...> {
+    };
+    
+    template <std::size_t... I>
+    struct make_indices<0, I...> {
+        typedef indices<I...> type;
+    };
+    
+    // How toAutowired resolves a constructor argument of type TArg
+    template <class TArg>
+    struct autowire_arg {
+        static_assert(sizeof(TArg) == 0, "toAutowired arguments must be sptr<IFace>, uptr<IFace> or Lazy<IFace>");
+    };
+    
+    template <class IFace>
+    struct autowire_arg<sptr<IFace>> {
+        typedef sptr<IFace> type;
+        binding_handle<IFace> handle;
+        
+        type resolve(const sptr<Context>& slc) {
+            return slc->resolveWith(handle);
+        }
+    };
+    
+    template <class IFace>
+    struct autowire_arg<uptr<IFace>> {
+        typedef uptr<IFace> type;
+        binding_handle<IFace> handle;
+        
+        type resolve(const sptr<Context>& slc) {
+            return slc->resolveUniqueWith(handle);
         }
+    };
+    
+    template <class IFace>
+    struct autowire_arg<Lazy<IFace>> {
+        typedef Lazy<IFace> type;
+        binding_handle<IFace> handle;
         
-        void visitAll(std::function<void(sptr<TypedServiceLocator<IFace>::shared_ptr_binding>)> fnVisit) {
-            for(auto binding : _bindings) {
-                auto ibinding = std::dynamic_pointer_cast<shared_ptr_binding>(binding.second);
-                fnVisit(ibinding);
-            }
+        type resolve(const sptr<Context>& slc) {
+            return slc->resolveLazyWith(handle);
         }
     };
     
+    template <class TArgs, std::size_t... I, class FnConstruct>
+    static auto autowire(TArgs& args, const sptr<Context>& slc, indices<I...>, FnConstruct fnConstruct) -> decltype(fnConstruct(std::get<I>(args).resolve(slc)...)) {
+        return fnConstruct(std::get<I>(args).resolve(slc)...);
+    }
+    
+    typedef std::pair<const std::type_index, sptr<AnyServiceLocator>> typed_locator_entry;
+    
+    // All of our containers, bindings and Contexts are allocated from _resource, instances created by the
+    // built in factories are allocated from _instanceResource when it is set
+    MemoryResource* _resource;
+    MemoryResource* _instanceResource;
+    
     // Named locator bindings (simple map from string to NamedServiceLocator)
-    std::map<std::type_index, AnyServiceLocator*> _typed_locators;
-    mutable std::list<AnyServiceLocator::loose_binding*> _eagerBindings;
+    std::map<std::type_index, sptr<AnyServiceLocator>, std::less<std::type_index>, Allocator<typed_locator_entry>> _typed_locators;
+    mutable std::list<loose_binding*, Allocator<loose_binding*>> _eagerBindings;
+    // Set while _eagerBindings has bindings to make, getContext() only takes _eagerMutex when it is.  Recursive
+    // as an eager binding's factory may well call getContext()
+    mutable std::atomic<bool> _eagerPending;
+    mutable std::recursive_mutex _eagerMutex;
+    
+#ifdef SERVICELOCATOR_STARTUP_PROFILE
+    mutable std::mutex _startupProfileMutex;
+    mutable std::vector<StartupProfileEntry> _startupProfile;
+#endif
+    
+    // Our Singletons in the order their construction completed (dependencies before dependants) along with
+    // the (dependant, dependency) pairs seen while constructing them, shutdown() releases them in reverse
+    typedef std::pair<loose_binding*, loose_binding*> singleton_dependency;
+    std::mutex _singletonMutex;
+    std::vector<loose_binding*, Allocator<loose_binding*>> _singletons;
+    std::vector<singleton_dependency, Allocator<singleton_dependency>> _singletonDependencies;
     
     sptr<ServiceLocator> _parent;
     sptr<Context> _context;
@@ -563,69 +2706,371 @@ private:
     // locators
     wptr<ServiceLocator> _this;
     
+    // Unique for the life of the process (unlike our address), and bumped on every bind - binding_handle's use
+    // these to know when a cached binding may be stale
+    const std::uint64_t _id;
+    std::atomic<std::uint64_t> _bindVersion;
+    
+    static std::uint64_t nextId() {
+        static std::atomic<std::uint64_t> id(0);
+        return ++id;
+    }
+    
+    // Moves whenever any ServiceLocator's _bindVersion does, so a cache for one locator can be checked with a
+    // single load rather than summing the versions of its chain
+    static std::atomic<std::uint64_t>& bindEpoch() {
+        static std::atomic<std::uint64_t> epoch(0);
+        return epoch;
+    }
+    
+    void bindingsChanged() {
+        _bindVersion++;
+        bindEpoch()++;
+    }
+    
+    std::uint64_t chainVersion() const {
+        auto version = _bindVersion.load(std::memory_order_acquire);
+        for(auto parent = _parent.get(); parent != nullptr; parent = parent->_parent.get()) {
+            version += parent->_bindVersion.load(std::memory_order_acquire);
+        }
+        return version;
+    }
+    
     template <class IFace>
     TypedServiceLocator<IFace>* getTypedServiceLocator(bool createIfRequired) {
         auto typeIndex = std::type_index(typeid(IFace));
         auto find = _typed_locators.find(typeIndex);
         if (find != _typed_locators.end()) {
-            return dynamic_cast<TypedServiceLocator<IFace>*>(find->second);
+            // Entries are keyed by their interface type
+            return static_cast<TypedServiceLocator<IFace>*>(find->second.get());
         }
         
         if (!createIfRequired) {
             return nullptr;
         }
         
-        auto nsl = new TypedServiceLocator<IFace>();
-        _typed_locators.insert(std::pair<std::type_index, AnyServiceLocator*>(typeIndex, nsl));
-        return nsl;
+        auto nsl = allocate_sptr<TypedServiceLocator<IFace>>(Allocator<TypedServiceLocator<IFace>>(_resource), _resource);
+        _typed_locators.insert(typed_locator_entry(typeIndex, nsl));
+        return nsl.get();
     }
     
-    // Hide default constructor - client should call ::create which returns a shared_ptr version
-    ServiceLocator() : ServiceLocator(nullptr) {
+    // Hide constructors - client should call ::create which returns a shared_ptr version
+    ServiceLocator(MemoryResource* resource, MemoryResource* instanceResource) : ServiceLocator(nullptr, resource, instanceResource) {
     }
 
     // Child locators keep a shared_ptr to their parent
-    ServiceLocator(sptr<ServiceLocator> parent) : _parent(parent) {
+    ServiceLocator(sptr<ServiceLocator> parent, MemoryResource* resource, MemoryResource* instanceResource)
+        :
+        _resource(resource),
+        _instanceResource(instanceResource),
+        _typed_locators(Allocator<typed_locator_entry>(resource)),
+        _eagerBindings(Allocator<loose_binding*>(resource)),
+        _eagerPending(false),
+        _singletons(Allocator<loose_binding*>(resource)),
+        _singletonDependencies(Allocator<singleton_dependency>(resource)),
+        _parent(parent),
+        _id(nextId()),
+        _bindVersion(0) {
     }
     
-    // Resolve a named interface, throws if not able to resolve
-    template <class IFace>
-    sptr<IFace> _resolve(sptr<Context> slc) {
-        auto& name = slc->getName();
-        auto nsl = getTypedServiceLocator<IFace>(false);
-        if (nsl == nullptr) {
-            if (_parent == nullptr) {
-                throw UnableToResolveException(std::string("Unable to resolve <") + slc->getInterfaceTypeName() + ">  resolve path = " + slc->getResolvePath());
-            }
-            return _parent->_resolve<IFace>(slc);
+    void singletonCreated(loose_binding* singleton) {
+        std::lock_guard<std::mutex> lock(_singletonMutex);
+        _singletons.push_back(singleton);
+    }
+    
+    void singletonDependency(loose_binding* dependant, loose_binding* dependency) {
+        std::lock_guard<std::mutex> lock(_singletonMutex);
+        _singletonDependencies.push_back(singleton_dependency(dependant, dependency));
+    }
+    
+    // ServiceLocators are placed in memory from their own MemoryResource, this deleter returns it
+    class resource_deleter {
+    private:
+        MemoryResource* _resource;
+        
+    public:
+        resource_deleter(MemoryResource* resource) : _resource(resource) {
         }
         
-        auto ptr = nsl->tryResolve(name, slc);
-        if (ptr == nullptr) {
-            if (_parent == nullptr) {
-                throw UnableToResolveException(std::string("Unable to resolve <") + slc->getInterfaceTypeName() + ">  resolve path = " + slc->getResolvePath());
+        void operator()(ServiceLocator* sl) const {
+            sl->~ServiceLocator();
+            _resource->deallocate(sl, sizeof(ServiceLocator), alignof(ServiceLocator));
+        }
+    };
+    
+    static sptr<ServiceLocator> allocate(sptr<ServiceLocator> parent, MemoryResource* resource, MemoryResource* instanceResource) {
+        auto p = resource->allocate(sizeof(ServiceLocator), alignof(ServiceLocator));
+        ServiceLocator* sl;
+        try {
+            sl = new (p) ServiceLocator(parent, resource, instanceResource);
+        } catch (...) {
+            resource->deallocate(p, sizeof(ServiceLocator), alignof(ServiceLocator));
+            throw;
+        }
+        auto slp = sptr<ServiceLocator>(sl, resource_deleter(resource), Allocator<ServiceLocator>(resource));
+        
+        // Keep a weak reference to ourselves (weird) - have to do this in order to be able to
+        // create children which have shared_ptr's to their parents - you cannot create 2 shared_ptr
+        // instances from a raw pointer you will crash on 2nd shared_ptr going out of scope and deleting
+        // the instance which has already been deleted by the 1st shared_ptr going out of scope
+        slp->_this = slp;
+        slp->_context = Context::makeContext(resource, slp.get());
+        
+        return slp;
+    }
+    
+    // n instances of T in 1 block of memory
+    template <class T>
+    class instance_block {
+    private:
+        MemoryResource* _resource;
+        T* _instances;
+        std::size_t _capacity;
+        std::size_t _size = 0;
+        
+    public:
+        instance_block(MemoryResource* resource, std::size_t capacity) : _resource(resource), _capacity(capacity) {
+            _instances = static_cast<T*>(_resource->allocate(capacity * sizeof(T), alignof(T)));
+        }
+        
+        instance_block(const instance_block&) = delete;
+        instance_block& operator=(const instance_block&) = delete;
+        
+        ~instance_block() {
+            while(_size > 0) {
+                _instances[--_size].~T();
             }
-            return _parent->_resolve<IFace>(slc);
+            _resource->deallocate(_instances, _capacity * sizeof(T), alignof(T));
         }
         
-        return ptr;
+        template <class... Args>
+        T* emplace(Args&&... args) {
+            auto instance = new (&_instances[_size]) T(std::forward<Args>(args)...);
+            _size++;
+            return instance;
+        }
+    };
+    
+    // Append n instances of T to out, they share 1 allocation and 1 reference count so are destroyed together once
+    // the last of them is released (see Context::resolveMany)
+    template <class T, class IFace, class... Args>
+    static void makeInstances(MemoryResource* resource, std::size_t n, std::vector<sptr<IFace>>* out, const Args&... args) {
+        if (n == 0) {
+            return;
+        }
+        auto block = makeInstance<instance_block<T>>(resource, resource != nullptr ? resource : defaultResource(), n);
+        for(std::size_t i = 0; i < n; i++) {
+            out->push_back(sptr<IFace>(block, block->emplace(args...)));
+        }
     }
-
+    
+    // Instances the built in factories create for resolveUnique.  C++11's new only aligns to
+    // alignof(std::max_align_t) so an over aligned T can't be owned by a uptr, resolve it instead
+    template <class IFace, class T, class... Args>
+    static uptr<IFace> newUnique(Args&&... args) {
+        return newUniqueAligned<IFace, T>(std::integral_constant<bool, (alignof(T) > alignof(std::max_align_t))>(), std::forward<Args>(args)...);
+    }
+    
+    template <class IFace, class T, class... Args>
+    static uptr<IFace> newUniqueAligned(std::false_type, Args&&... args) {
+        return uptr<IFace>(new T(std::forward<Args>(args)...));
+    }
+    
+    template <class IFace, class T, class... Args>
+    static uptr<IFace> newUniqueAligned(std::true_type, Args&&...) {
+        throw BindingIssueException("resolveUnique<" + Context::getTypeName(std::type_index(typeid(IFace))) + "> cannot create over aligned " + Context::getTypeName(std::type_index(typeid(T))));
+    }
+    
+    // Instances created by the built in factories, single allocation either way
+    template <class T, class... Args>
+    static sptr<T> makeInstance(MemoryResource* resource, Args&&... args) {
+        if (resource == nullptr) {
+            return make_sptr<T>(std::forward<Args>(args)...);
+        }
+        return allocate_sptr<T>(Allocator<T>(resource), std::forward<Args>(args)...);
+    }
+    
     // Resolve a named interface, throws if not able to resolve
     template <class IFace>
-    void _visitAll(std::function<void(sptr<typename TypedServiceLocator<IFace>::shared_ptr_binding>)> fnVisit) {
+    sptr<IFace> _resolve(const sptr<Context>& slc) {
+        typename TypedServiceLocator<IFace>::shared_ptr_binding* binding;
+        return _resolve<IFace>(slc, binding);
+    }
+    
+    // As above, setting resolvedBy to the binding found for it (which _resolveFrom resolves the same)
+    template <class IFace>
+    sptr<IFace> _resolve(const sptr<Context>& slc, typename TypedServiceLocator<IFace>::shared_ptr_binding*& resolvedBy) {
+        auto binding = _findBinding<IFace>(slc->getName());
+        if (binding == nullptr) {
+            throw UnableToResolveException(std::string("Unable to resolve <") + slc->getInterfaceTypeName() + ">  resolve path = " + slc->getResolvePath());
+        }
+        resolvedBy = binding;
+        return _resolveFrom<IFace>(binding, slc);
+    }
+    
+    // Resolve from a binding found for slc, a binding resolving to nullptr falls back to the parent of the
+    // ServiceLocator owning it.  Every resolve from an already known binding (Plans, binding_handles ..) comes
+    // through here so it gives the same result as a plain resolve
+    template <class IFace>
+    static sptr<IFace> _resolveFrom(typename TypedServiceLocator<IFace>::shared_ptr_binding* binding, const sptr<Context>& slc) {
+        auto ptr = binding->get(slc);
+        if (ptr != nullptr) {
+            return ptr;
+        }
+        ServiceLocator* parent = binding->getServiceLocator()->_parent.get();
+        if (parent == nullptr) {
+            throw UnableToResolveException(std::string("Unable to resolve <") + slc->getInterfaceTypeName() + ">  resolve path = " + slc->getResolvePath());
+        }
+        return parent->_resolve<IFace>(slc);
+    }
+
+    // An alias resolves its target in place (see alias), so a cycle of aliases never reaches a Context the
+    // recursive resolve check would catch it in.  Follows the chain from alias's target (tortoise and hare, so
+    // nothing is allocated) and throws if it loops, before anything is resolved.  Only a target which is itself an
+    // alias costs more than 1 call
+    static void _checkAliasCycle(loose_binding* alias, loose_binding* target, ServiceLocator* sl, Context* ctx) {
+        auto slow = alias;
+        auto fast = target;
+        while(true) {
+            fast = fast->aliasTarget(sl);
+            if (fast == nullptr) {
+                return;
+            }
+            fast = fast->aliasTarget(sl);
+            if (fast == nullptr) {
+                return;
+            }
+            slow = slow->aliasTarget(sl);
+            if (slow == fast) {
+                throw RecursiveResolveException("Recursive alias resolve path = " + ctx->getResolvePath());
+            }
+        }
+    }
+    
+    // Find the binding for a named interface walking up our parents, nullptr if there is none
+    template <class IFace>
+    typename TypedServiceLocator<IFace>::shared_ptr_binding* _findBinding(const std::string& name) {
         auto nsl = getTypedServiceLocator<IFace>(false);
         if (nsl != nullptr) {
-            nsl->visitAll(fnVisit);
+            auto binding = nsl->find(name);
+            if (binding != nullptr) {
+                return binding;
+            }
+        }
+        if (_parent == nullptr) {
+            return nullptr;
+        }
+        return _parent->_findBinding<IFace>(name);
+    }
+    
+    // Resolve a named transient interface to a uptr, throws if not able to resolve
+    template <class IFace>
+    uptr<IFace> _resolveUnique(const sptr<Context>& slc, typename TypedServiceLocator<IFace>::shared_ptr_binding*& resolvedBy) {
+        auto binding = _findBinding<IFace>(slc->getName());
+        if (binding == nullptr) {
+            throw UnableToResolveException(std::string("Unable to resolve <") + slc->getInterfaceTypeName() + ">  resolve path = " + slc->getResolvePath());
+        }
+        resolvedBy = binding;
+        return binding->getUnique(slc);
+    }
+
+    // Resolve a named Singleton or Instance by reference, throws if not able to resolve
+    template <class IFace>
+    IFace& _resolveRef(const sptr<Context>& slc, typename TypedServiceLocator<IFace>::shared_ptr_binding*& resolvedBy) {
+        auto binding = _findBinding<IFace>(slc->getName());
+        if (binding == nullptr) {
+            throw UnableToResolveException(std::string("Unable to resolve <") + slc->getInterfaceTypeName() + ">  resolve path = " + slc->getResolvePath());
+        }
+        resolvedBy = binding;
+        return binding->getRef(slc);
+    }
+
+    // The nearest of us and our parents with bindings of IFace, any below it would see the same bindings.
+    // nullptr when there are none
+    template <class IFace>
+    TypedServiceLocator<IFace>* _nearestTypedServiceLocator(ServiceLocator*& owner) {
+        owner = this;
+        auto nsl = getTypedServiceLocator<IFace>(false);
+        while(nsl == nullptr && owner->_parent != nullptr) {
+            owner = owner->_parent.get();
+            nsl = owner->getTypedServiceLocator<IFace>(false);
+        }
+        return nsl;
+    }
+    
+    // The bindings resolveAll visits, see TypedServiceLocator::merged_view.  nullptr when there are none
+    template <class IFace>
+    sptr<const typename TypedServiceLocator<IFace>::merged_view> _mergedBindings() {
+        typedef typename TypedServiceLocator<IFace>::merged_view merged_view;
+        typedef typename TypedServiceLocator<IFace>::shared_ptr_binding binding_type;
+        
+        ServiceLocator* owner;
+        auto nsl = _nearestTypedServiceLocator<IFace>(owner);
+        if (nsl == nullptr) {
+            return nullptr;
+        }
+        
+        auto version = owner->chainVersion();
+        auto cached = std::atomic_load(&nsl->_mergedView);
+        if (cached != nullptr && cached->version == version) {
+            return cached;
+        }
+        
+        auto view = make_sptr<merged_view>();
+        view->version = version;
+        std::set<std::string> names;
+        for(auto sl = owner; sl != nullptr; sl = sl->_parent.get()) {
+            auto typed = sl->getTypedServiceLocator<IFace>(false);
+            if (typed != nullptr) {
+                for(auto& binding : typed->_bindings) {
+                    if (names.insert(binding.first).second) {
+                        view->bindings.push_back(static_cast<binding_type*>(binding.second.get()));
+                    }
+                }
+            }
+        }
+        std::stable_sort(view->bindings.begin(), view->bindings.end(), [] (const binding_type* a, const binding_type* b) {
+            return a->getPriority() < b->getPriority();
+        });
+        std::atomic_store(&nsl->_mergedView, sptr<const merged_view>(view));
+        return view;
+    }
+    
+    template <class IFace>
+    sptr<const std::vector<sptr<IFace>>> _resolveAllShared(Context* slc) {
+        typedef typename TypedServiceLocator<IFace>::all_snapshot all_snapshot;
+        
+        // The snapshot is kept with the merged view
+        ServiceLocator* owner;
+        auto nsl = _nearestTypedServiceLocator<IFace>(owner);
+        
+        auto version = owner->chainVersion();
+        // A Singleton under construction must resolve to record its dependencies
+        auto useCache = nsl != nullptr && slc->_dependant == nullptr;
+        if (useCache) {
+            auto cached = std::atomic_load(&nsl->_allSnapshot);
+            if (cached != nullptr && cached->version == version) {
+                return sptr<const std::vector<sptr<IFace>>>(cached, &cached->all);
+            }
         }
         
-        if (_parent != nullptr) {
-            _parent->_visitAll<IFace>(fnVisit);
+        auto snapshot = make_sptr<all_snapshot>();
+        snapshot->version = version;
+        auto range = slc->resolveAllRange<IFace>();
+        for(auto it = range.begin(); it != range.end(); ++it) {
+            snapshot->all.push_back(*it);
+            if (it.binding()->existingInstance() == nullptr) {
+                useCache = false;
+            }
+        }
+        if (useCache) {
+            std::atomic_store(&nsl->_allSnapshot, sptr<const all_snapshot>(snapshot));
         }
+        return sptr<const std::vector<sptr<IFace>>>(snapshot, &snapshot->all);
     }
 
     template <class IFace>
-    bool _canResolve(sptr<Context> slc) {
+    bool _canResolve(const sptr<Context>& slc) {
         auto nsl = getTypedServiceLocator<IFace>(false);
         if (nsl == nullptr) {
             if (_parent == nullptr) {
@@ -638,74 +3083,412 @@ private:
         return nsl->canResolve(slc->getName());
     }
     
-    // Try to resolve a named interface, returns nullptr on failure
+    // Try to resolve a named interface, returns nullptr on failure.  resolvedBy is set to the binding resolved from
     template <class IFace>
-    sptr<IFace> _tryResolve(sptr<Context> slc) {
+    sptr<IFace> _tryResolve(const sptr<Context>& slc, typename TypedServiceLocator<IFace>::shared_ptr_binding*& resolvedBy) {
         auto nsl = getTypedServiceLocator<IFace>(false);
         if (nsl == nullptr) {
             if (_parent == nullptr) {
                 return nullptr;
             }
             
-            return _parent->_tryResolve<IFace>(slc);
+            return _parent->_tryResolve<IFace>(slc, resolvedBy);
         }
 
-        auto ptr = nsl->tryResolve(slc->getName(), slc);
+        auto ptr = nsl->tryResolve(slc->getName(), slc, resolvedBy);
         if (ptr == nullptr && _parent != nullptr) {
-            return _parent->_tryResolve<IFace>(slc);
+            return _parent->_tryResolve<IFace>(slc, resolvedBy);
         }
         return ptr;
     }
 
-public:
-    // Create a root ServiceLocator
-    static sptr<ServiceLocator> create() {
-        auto slp = sptr<ServiceLocator>(new ServiceLocator());
+#ifdef SERVICELOCATOR_METRICS
+    struct graph_node {
+        loose_binding* binding;
+        std::size_t locator;
+    };
+    
+    // Nodes are ordered by locator, nearest first
+    void collectGraph(std::vector<graph_node>* nodes) const {
+        std::size_t locator = 0;
+        for(auto sl = this; sl != nullptr; sl = sl->_parent.get(), locator++) {
+            for(auto& typed : sl->_typed_locators) {
+                typed.second->forEachBinding([nodes, locator] (loose_binding* binding) {
+                    nodes->push_back(graph_node { binding, locator });
+                });
+            }
+        }
+    }
+    
+    // The edges from each node to the nodes its dependencies resolve to from us (the nearest binding of the
+    // interface and name), dependencies on bindings outside the graph are left out
+    static std::vector<std::pair<std::size_t, std::size_t>> collectEdges(const std::vector<graph_node>& nodes) {
+        std::multimap<std::pair<std::type_index, std::string>, std::size_t> byKey;
+        for(std::size_t id = 0; id < nodes.size(); id++) {
+            byKey.insert(std::make_pair(std::make_pair(nodes[id].binding->getInterfaceType(), nodes[id].binding->getName()), id));
+        }
         
-        // Keep a weak reference to ourselves (weird) - have to do this in order to be able to
-        // create children which have shared_ptr's to their parents - you cannot create 2 shared_ptr
-        // instances from a raw pointer you will crash on 2nd shared_ptr going out of scope and deleting
-        // the instance which has already been deleted by the 1st shared_ptr going out of scope
-        slp->_this = slp;
-        slp->_context = sptr<Context>(new Context(slp));
+        std::vector<std::pair<std::size_t, std::size_t>> edges;
+        for(std::size_t from = 0; from < nodes.size(); from++) {
+            std::vector<std::size_t> to;
+            for(auto dependency = nodes[from].binding->getDependencies(); dependency != nullptr; dependency = dependency->next) {
+                // Equal keys keep their insertion order, so the first is the nearest
+                auto nearest = byKey.find(std::make_pair(dependency->interfaceType, dependency->name));
+                if (nearest != byKey.end()) {
+                    to.push_back(nearest->second);
+                }
+            }
+            // Dependencies are recorded newest first
+            for(auto id = to.rbegin(); id != to.rend(); id++) {
+                edges.push_back(std::make_pair(from, *id));
+            }
+        }
+        return edges;
+    }
+    
+    static const char* lifetimeName(Lifetime lifetime) {
+        switch(lifetime) {
+            case Lifetime::Singleton:
+                return "Singleton";
+            case Lifetime::Instance:
+                return "Instance";
+            default:
+                return "Transient";
+        }
+    }
+    
+    // Escapes quotes and backslashes, as both JSON and DOT strings need
+    static std::string graphEscape(const std::string& s) {
+        std::string escaped;
+        for(auto c : s) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+#endif
 
-        return slp;
+    // Drop the cached resolveAllShared arrays so they don't keep Singletons alive past shutdown
+    void _releaseCaches() {
+        for(auto& typed : _typed_locators) {
+            typed.second->releaseCaches();
+        }
+        // Anything cached by us or our children is stale once our Singletons are released
+        bindingsChanged();
+    }
+
+public:
+    // Create a root ServiceLocator, bindings and Contexts are allocated from resource (the global heap by default).
+    // When allocateInstances is set the built in factories (toSelf(), to<TImpl>() ..) allocate instances from
+    // resource as well
+    static sptr<ServiceLocator> create(MemoryResource* resource = defaultResource(), bool allocateInstances = false) {
+        return allocate(nullptr, resource, allocateInstances ? resource : nullptr);
     }
     
     virtual ~ServiceLocator() {
+        shutdown();
+    }
+    
+    // Release our Singletons in reverse dependency order, each Singleton is released before the Singletons it
+    // depends on.  Resolving a Singleton after shutdown creates it afresh.  Called by the destructor.  Resolves
+    // of our Singletons take no lock once they are created, so shutdown must not run while other threads are
+    // resolving from us or our children
+    void shutdown() {
+        _releaseCaches();
+        
+        std::vector<loose_binding*> singletons;
+        {
+            std::lock_guard<std::mutex> lock(_singletonMutex);
+            singletons.assign(_singletons.begin(), _singletons.end());
+            _singletons.clear();
+            _singletonDependencies.clear();
+        }
+        for(auto singleton = singletons.rbegin(); singleton != singletons.rend(); singleton++) {
+            (*singleton)->releaseInstance();
+        }
+    }
+    
+    // As above but Singletons with no remaining dependants are released together on executor, in waves.  Any in
+    // a dependency cycle never run out of dependants, they are released last in reverse construction order
+    void shutdown(const Executor& executor) {
+        _releaseCaches();
+        
+        std::vector<loose_binding*> singletons;
+        std::vector<singleton_dependency> dependencies;
+        {
+            std::lock_guard<std::mutex> lock(_singletonMutex);
+            singletons.assign(_singletons.rbegin(), _singletons.rend());
+            dependencies.assign(_singletonDependencies.begin(), _singletonDependencies.end());
+            _singletons.clear();
+            _singletonDependencies.clear();
+        }
+        
+        // Count each Singleton's dependants, dependencies on other ServiceLocator's Singletons are not ours to order
+        std::map<loose_binding*, int> dependants;
+        std::multimap<loose_binding*, loose_binding*> dependenciesOf;
+        for(auto singleton : singletons) {
+            dependants[singleton] = 0;
+        }
+        for(auto& dependency : dependencies) {
+            if (dependants.count(dependency.first) && dependants.count(dependency.second)) {
+                dependants[dependency.second]++;
+                dependenciesOf.insert(dependency);
+            }
+        }
+        
+        std::vector<loose_binding*> wave;
+        for(auto singleton : singletons) {
+            if (dependants[singleton] == 0) {
+                wave.push_back(singleton);
+            }
+        }
+        std::set<loose_binding*> released;
+        while(!wave.empty()) {
+            std::vector<std::function<void()>> tasks;
+            for(auto singleton : wave) {
+                released.insert(singleton);
+                tasks.push_back([singleton] () {
+                    singleton->releaseInstance();
+                });
+            }
+            executor(tasks);
+            
+            std::vector<loose_binding*> next;
+            for(auto singleton : wave) {
+                auto range = dependenciesOf.equal_range(singleton);
+                for(auto dependency = range.first; dependency != range.second; dependency++) {
+                    if (--dependants[dependency->second] == 0) {
+                        next.push_back(dependency->second);
+                    }
+                }
+            }
+            wave.swap(next);
+        }
+        
+        for(auto singleton : singletons) {
+            if (released.count(singleton) == 0) {
+                singleton->releaseInstance();
+            }
+        }
     }
     
     // Create a child ServiceLocator.  Children can override parent bindings or add new ones (they cannot delete
     // a parent binding).  Children will revert to their parents for unresolved bindings
     sptr<ServiceLocator> enter() {
-        auto slp = sptr<ServiceLocator>(new ServiceLocator(sptr<ServiceLocator>(_this)));
-        slp->_this = slp;
-        slp->_context = sptr<Context>(new Context(slp));
-        return slp;
+        return allocate(sptr<ServiceLocator>(_this), _resource, _instanceResource);
+    }
+    
+    // Create a child ServiceLocator allocating from its own resource, eg a MonotonicBufferResource per request
+    sptr<ServiceLocator> enter(MemoryResource* resource, bool allocateInstances = false) {
+        return allocate(sptr<ServiceLocator>(_this), resource, allocateInstances ? resource : nullptr);
     }
     
     // Create a named binding
     template <class IFace>
     typename TypedServiceLocator<IFace>::shared_ptr_binding::to_clause& bind(const std::string& named) {
         auto nsl = getTypedServiceLocator<IFace>(true);
-        
-        return nsl->bind(named, &_eagerBindings);
+        auto& clause = nsl->bind(named, this);
+        bindingsChanged();
+        return clause;
     }
     
     // Create a binding
     template <class IFace>
     typename TypedServiceLocator<IFace>::shared_ptr_binding::to_clause& bind() {
-        auto nsl = getTypedServiceLocator<IFace>(true);
+        return bind<IFace>("");
+    }
+    
+    // A Plan resolving a named IFace.  Factories are only known by running them, so the Plan records the
+    // bindings of its first execute and later executes replay them, skipping the binding lookups and recursive
+    // resolve checks.  A factory resolving something other than what was recorded falls back to a normal resolve
+    template <class IFace>
+    Plan<IFace> compilePlan(const std::string& named = "") {
+        return Plan<IFace>(sptr<ServiceLocator>(_this), named);
+    }
+    
+    // A callable resolving a named IFace, unlike Context::provider it skips the binding lookup until a new binding
+    // could change which binding it resolves from.  Keeps this ServiceLocator alive
+    template <class IFace>
+    Factory<IFace> factory(const std::string& named = "") {
+        return Factory<IFace>(sptr<ServiceLocator>(_this), named);
+    }
+    
+#ifdef SERVICELOCATOR_METRICS
+    struct BindingMetrics {
+        std::string interfaceTypeName;
+        std::string name;
+        // Instances handed out, hits are those not constructed for the resolve (a Singleton after the 1st, an
+        // Instance).  Arrays resolveAllShared returns from its cache aren't counted
+        std::uint64_t resolves;
+        std::uint64_t hits;
+        std::uint64_t constructions;
+        // Construction times include constructing any dependencies
+        std::uint64_t constructionNanos;
+        // constructionHistogram[i] counts constructions taking [2^i, 2^(i + 1)) nanoseconds
+        std::vector<std::uint64_t> constructionHistogram;
+    };
+    
+    // A snapshot of the metrics of each of our bindings, taken without stopping other threads resolving so
+    // the counts may be mid update relative to each other
+    std::vector<BindingMetrics> getMetrics() const {
+        std::vector<BindingMetrics> snapshot;
+        for(auto& typed : _typed_locators) {
+            typed.second->forEachBinding([&snapshot] (loose_binding* binding) {
+                auto& metrics = binding->getMetrics();
+                BindingMetrics entry;
+                entry.interfaceTypeName = Context::getTypeName(binding->getInterfaceType());
+                entry.name = binding->getName();
+                entry.constructions = metrics.constructions();
+                entry.resolves = metrics.resolves();
+                entry.hits = entry.resolves > entry.constructions ? entry.resolves - entry.constructions : 0;
+                entry.constructionNanos = metrics.constructionNanos();
+                for(int bucket = 0; bucket < loose_binding::binding_metrics::buckets; bucket++) {
+                    entry.constructionHistogram.push_back(metrics.histogram(bucket));
+                }
+                snapshot.push_back(std::move(entry));
+            });
+        }
+        return snapshot;
+    }
+    
+    // Our bindings and our parents' as a Graphviz digraph, each annotated with its lifetime and metrics, with an
+    // edge to each dependency seen resolving from within it so far.  Overridden parent bindings are included,
+    // their locator is the number of parents up they are bound in
+    std::string exportGraphDot() const {
+        std::vector<graph_node> nodes;
+        collectGraph(&nodes);
+        
+        std::ostringstream dot;
+        dot << "digraph ServiceLocator {\n";
+        for(std::size_t id = 0; id < nodes.size(); id++) {
+            auto& node = nodes[id];
+            auto& metrics = node.binding->getMetrics();
+            std::ostringstream label;
+            label << Context::getTypeName(node.binding->getInterfaceType());
+            if (!node.binding->getName().empty()) {
+                label << " \\\"" << graphEscape(node.binding->getName()) << "\\\"";
+            }
+            label << "\\n" << lifetimeName(node.binding->getLifetime()) << ", locator " << node.locator;
+            label << "\\n" << metrics.constructions() << " constructed in " << metrics.constructionNanos() << "ns, " << metrics.resolves() << " resolved";
+            dot << "  n" << id << " [label=\"" << label.str() << "\"];\n";
+        }
+        for(auto& edge : collectEdges(nodes)) {
+            dot << "  n" << edge.first << " -> n" << edge.second << ";\n";
+        }
+        dot << "}\n";
+        return dot.str();
+    }
+    
+    // As exportGraphDot, as {"nodes":[{"id":0,"interface":"IFoo","name":"","locator":0,"lifetime":"Singleton",..}],
+    // "edges":[{"from":0,"to":1}]}
+    std::string exportGraphJson() const {
+        std::vector<graph_node> nodes;
+        collectGraph(&nodes);
         
-        return nsl->bind("", &_eagerBindings);
+        std::ostringstream json;
+        json << "{\"nodes\":[";
+        for(std::size_t id = 0; id < nodes.size(); id++) {
+            auto& node = nodes[id];
+            auto& metrics = node.binding->getMetrics();
+            json << (id == 0 ? "" : ",") << "{\"id\":" << id;
+            json << ",\"interface\":\"" << graphEscape(Context::getTypeName(node.binding->getInterfaceType())) << "\"";
+            json << ",\"name\":\"" << graphEscape(node.binding->getName()) << "\"";
+            json << ",\"locator\":" << node.locator;
+            json << ",\"lifetime\":\"" << lifetimeName(node.binding->getLifetime()) << "\"";
+            json << ",\"resolves\":" << metrics.resolves();
+            json << ",\"constructions\":" << metrics.constructions();
+            json << ",\"constructionNanos\":" << metrics.constructionNanos() << "}";
+        }
+        json << "],\"edges\":[";
+        auto first = true;
+        for(auto& edge : collectEdges(nodes)) {
+            json << (first ? "" : ",") << "{\"from\":" << edge.first << ",\"to\":" << edge.second << "}";
+            first = false;
+        }
+        json << "]}";
+        return json.str();
+    }
+#endif
+    
+#ifdef SERVICELOCATOR_COUNT_ALLOCATIONS
+    // Called by the operator new SERVICELOCATOR_DEFINE_ALLOCATION_HOOKS defines
+    static void countAllocation(std::size_t size) {
+        auto binding = loose_binding::allocatingBinding();
+        if (binding != nullptr) {
+            binding->countAllocation(size);
+        }
+    }
+    
+    struct BindingAllocations {
+        std::string interfaceTypeName;
+        std::string name;
+        std::uint64_t allocations;
+        std::uint64_t bytes;
+    };
+    
+    // The heap allocations made so far while each of our bindings resolved: its instances, their control blocks,
+    // the Contexts and strings of their dependencies' resolves ..  A dependency's own allocations count against
+    // its binding, and the Context a binding is resolved from counts against the resolve which needed it
+    std::vector<BindingAllocations> getAllocationCounts() const {
+        std::vector<BindingAllocations> counts;
+        for(auto& typed : _typed_locators) {
+            typed.second->forEachBinding([&counts] (loose_binding* binding) {
+                counts.push_back(BindingAllocations { Context::getTypeName(binding->getInterfaceType()), binding->getName(), binding->getAllocations(), binding->getAllocatedBytes() });
+            });
+        }
+        return counts;
+    }
+#endif
+    
+#ifdef SERVICELOCATOR_COUNT_INSTANCES
+    struct BindingInstances {
+        std::string interfaceTypeName;
+        std::string name;
+        std::uint64_t live;
+        // The sizes of the live instances' concrete types, 0 for those created by a factory not naming its type
+        std::uint64_t bytes;
+        // The most live at once
+        std::uint64_t highWater;
+    };
+    
+    // The instances constructed by each of our bindings which are still alive, a transient binding with a growing
+    // count is having its instances retained (eg by a Singleton).  Instance bindings and resolveUnique's
+    // instances are not counted
+    std::vector<BindingInstances> getInstanceCounts() const {
+        std::vector<BindingInstances> counts;
+        for(auto& typed : _typed_locators) {
+            typed.second->forEachBinding([&counts] (loose_binding* binding) {
+                auto& instances = binding->getInstanceCounts();
+                counts.push_back(BindingInstances { Context::getTypeName(binding->getInterfaceType()), binding->getName(), instances.live.load(std::memory_order_relaxed), instances.bytes.load(std::memory_order_relaxed), instances.highWater.load(std::memory_order_relaxed) });
+            });
+        }
+        return counts;
     }
+#endif
+    
+#ifdef SERVICELOCATOR_STARTUP_PROFILE
+    // The time taken by each module added to us and each of our eager bindings, and by the constructions
+    // nested in them
+    std::vector<StartupProfileEntry> getStartupProfile() const {
+        std::lock_guard<std::mutex> lock(_startupProfileMutex);
+        return _startupProfile;
+    }
+#endif
     
+    // The 1st call makes our eager bindings, threads calling it meanwhile wait for them to be made.  The
+    // Context must not outlive us
     sptr<Context> getContext() const {
-        if (_eagerBindings.size() > 0) {
-            for(auto eagerBinding : _eagerBindings) {
+        if (_eagerPending.load(std::memory_order_acquire)) {
+            std::lock_guard<std::recursive_mutex> lock(_eagerMutex);
+            while(!_eagerBindings.empty()) {
+                auto eagerBinding = _eagerBindings.front();
+                _eagerBindings.pop_front();
+                startup_scope profile(this, eagerBinding);
                 eagerBinding->eagerBind(_context);
             }
-            _eagerBindings.clear();
+            _eagerPending.store(false, std::memory_order_release);
         }
         return _context;
     }
@@ -743,16 +3526,18 @@ public:
     
     class module_clause {
     private:
-        mutable sptr<ServiceLocator> _sl;
+        // Not a shared_ptr, we are owned by the ServiceLocator and would keep it alive forever
+        ServiceLocator* _sl;
     
     public:
-        module_clause(sptr<ServiceLocator> sl) : _sl(sl) {
+        module_clause(ServiceLocator* sl) : _sl(sl) {
         }
         
         template <class TModule>
         module_clause& add() {
+            startup_scope profile(_sl, typeid(TModule));
             auto module = uptr<TModule>(new TModule());
-            module->_sl = _sl;
+            module->_sl = sptr<ServiceLocator>(_sl->_this);
             
             module->load();
             
@@ -760,7 +3545,8 @@ public:
         }
 
         module_clause& add(ServiceLocator::Module&& module) {
-            module._sl = _sl;
+            startup_scope profile(_sl, typeid(module));
+            module._sl = sptr<ServiceLocator>(_sl->_this);
             
             module.load();
             
@@ -768,7 +3554,8 @@ public:
         }
 
         module_clause& add(ServiceLocator::Module& module) {
-            module._sl = _sl;
+            startup_scope profile(_sl, typeid(module));
+            module._sl = sptr<ServiceLocator>(_sl->_this);
             
             module.load();
             
@@ -780,7 +3567,7 @@ public:
     sptr<module_clause> _module_clause;
     module_clause& modules() {
         if (_module_clause == nullptr) {
-            _module_clause = sptr<module_clause>(new module_clause(sptr<ServiceLocator>(_this)));
+            _module_clause = sptr<module_clause>(new module_clause(this));
         }
         return *_module_clause;
     }
@@ -0,0 +1,232 @@
+/*
+   Copyright 2020 Steve Fillingham
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef StaticServiceLocator_hpp
+#define StaticServiceLocator_hpp
+
+#include "ServiceLocator.hpp"
+
+// Bindings for a StaticServiceLocator, TImpl is constructed as TImpl(sptr<TDeps>...)
+
+// New TImpl on every resolve
+template <class IFace, class TImpl, class... TDeps>
+struct StaticTransient {
+};
+
+// 1 TImpl for the life of the StaticServiceLocator
+template <class IFace, class TImpl, class... TDeps>
+struct StaticSingleton {
+};
+
+// IFace is resolved from the runtime ServiceLocator given to the StaticServiceLocator
+template <class IFace>
+struct StaticExternal {
+};
+
+// A ServiceLocator whose bindings are fixed at compile time, eg
+//
+// StaticServiceLocator<
+//     StaticSingleton<IFoo, Foo>,
+//     StaticTransient<IBar, Bar, IFoo, IBaz>,
+//     StaticExternal<IBaz>
+// > ssl(sl);
+//
+// auto bar = ssl.resolve<IBar>();
+//
+// resolve<IFace>() compiles down to constructing TImpl (or returning the Singleton), there are no lookups.  Missing
+// bindings, more than one binding for an interface and circular dependencies are compile errors.  StaticExternal
+// bindings are resolved from the runtime ServiceLocator, and exportTo() binds every static binding into a runtime
+// ServiceLocator so code resolving through a Context continues to work
+template <class... TBindings>
+class StaticServiceLocator {
+private:
+    template <class... T>
+    struct type_list {
+    };
+
+    template <class TList, class T>
+    struct append;
+
+    template <class... T, class TLast>
+    struct append<type_list<T...>, TLast> {
+        typedef type_list<T..., TLast> type;
+    };
+
+    template <class T, class TList>
+    struct contains : std::false_type {
+    };
+
+    template <class T, class TFirst, class... TRest>
+    struct contains<T, type_list<TFirst, TRest...>> : std::integral_constant<bool, std::is_same<T, TFirst>::value || contains<T, type_list<TRest...>>::value> {
+    };
+
+    template <class TBinding>
+    struct interface_of;
+
+    template <class IFace, class TImpl, class... TDeps>
+    struct interface_of<StaticTransient<IFace, TImpl, TDeps...>> {
+        typedef IFace type;
+    };
+
+    template <class IFace, class TImpl, class... TDeps>
+    struct interface_of<StaticSingleton<IFace, TImpl, TDeps...>> {
+        typedef IFace type;
+    };
+
+    template <class IFace>
+    struct interface_of<StaticExternal<IFace>> {
+        typedef IFace type;
+    };
+
+    template <bool Found, std::size_t Index>
+    struct found_at {
+        static const bool found = Found;
+        static const std::size_t value = Index;
+    };
+
+    template <class IFace, std::size_t Index, class... T>
+    struct index_of : found_at<false, 0> {
+    };
+
+    template <class IFace, std::size_t Index, class TFirst, class... TRest>
+    struct index_of<IFace, Index, TFirst, TRest...> : std::conditional<std::is_same<IFace, typename interface_of<TFirst>::type>::value, found_at<true, Index>, index_of<IFace, Index + 1, TRest...>>::type {
+    };
+
+    // True when no two bindings are for the same interface
+    template <class... T>
+    struct unique_interfaces : std::true_type {
+    };
+
+    template <class TFirst, class... TRest>
+    struct unique_interfaces<TFirst, TRest...> : std::integral_constant<bool, !index_of<typename interface_of<TFirst>::type, 0, TRest...>::found && unique_interfaces<TRest...>::value> {
+    };
+
+    static_assert(unique_interfaces<TBindings...>::value, "StaticServiceLocator has more than one binding for an interface");
+
+    template <class TBinding>
+    struct is_singleton : std::false_type {
+    };
+
+    template <class IFace, class TImpl, class... TDeps>
+    struct is_singleton<StaticSingleton<IFace, TImpl, TDeps...>> : std::true_type {
+    };
+
+    // Per binding state, only Singletons have any
+    template <class TBinding>
+    struct slot {
+    };
+
+    template <class IFace, class TImpl, class... TDeps>
+    struct slot<StaticSingleton<IFace, TImpl, TDeps...>> {
+        sptr<IFace> instance;
+        std::atomic<bool> created;
+        std::mutex createMutex;
+
+        slot() : created(false) {
+        }
+    };
+
+    std::tuple<slot<TBindings>...> _slots;
+    sptr<ServiceLocator> _fallback;
+
+    template <class IFace, class TPath>
+    struct binding_of {
+        typedef index_of<IFace, 0, TBindings...> index;
+        static_assert(index::found, "StaticServiceLocator has no binding for IFace");
+        static_assert(!contains<IFace, TPath>::value, "StaticServiceLocator circular dependency");
+        typedef typename std::tuple_element<index::value, std::tuple<TBindings...>>::type type;
+    };
+
+    template <class IFace, class TPath>
+    sptr<IFace> resolvePath() {
+        typedef binding_of<IFace, TPath> binding;
+        return get<TPath>(static_cast<typename binding::type*>(nullptr), std::get<binding::index::value>(_slots));
+    }
+
+    template <class TPath, class IFace, class TImpl, class... TDeps>
+    sptr<IFace> get(StaticTransient<IFace, TImpl, TDeps...>*, slot<StaticTransient<IFace, TImpl, TDeps...>>&) {
+        return make_sptr<TImpl>(resolvePath<TDeps, typename append<TPath, IFace>::type>()...);
+    }
+
+    template <class TPath, class IFace, class TImpl, class... TDeps>
+    const sptr<IFace>& get(StaticSingleton<IFace, TImpl, TDeps...>*, slot<StaticSingleton<IFace, TImpl, TDeps...>>& singleton) {
+        if (!singleton.created.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(singleton.createMutex);
+            if (!singleton.created.load(std::memory_order_relaxed)) {
+                singleton.instance = make_sptr<TImpl>(resolvePath<TDeps, typename append<TPath, IFace>::type>()...);
+                singleton.created.store(true, std::memory_order_release);
+            }
+        }
+        return singleton.instance;
+    }
+
+    template <class TPath, class IFace>
+    sptr<IFace> get(StaticExternal<IFace>*, slot<StaticExternal<IFace>>&) {
+        if (_fallback == nullptr) {
+            throw UnableToResolveException(std::string("StaticExternal binding has no runtime ServiceLocator to resolve from"));
+        }
+        return _fallback->getContext()->template resolve<IFace>();
+    }
+
+    template <class IFace, class TImpl, class... TDeps>
+    void exportBinding(const sptr<ServiceLocator>& sl, StaticTransient<IFace, TImpl, TDeps...>*) {
+        sl->bind<IFace>().toSelf([this] (const SLContext_sptr&) {
+            return resolve<IFace>();
+        });
+    }
+
+    template <class IFace, class TImpl, class... TDeps>
+    void exportBinding(const sptr<ServiceLocator>& sl, StaticSingleton<IFace, TImpl, TDeps...>*) {
+        sl->bind<IFace>().toSelf([this] (const SLContext_sptr&) {
+            return resolve<IFace>();
+        }).asSingleton();
+    }
+
+    template <class IFace>
+    void exportBinding(const sptr<ServiceLocator>&, StaticExternal<IFace>*) {
+        // Already a runtime binding
+    }
+
+public:
+    StaticServiceLocator(sptr<ServiceLocator> fallback = nullptr) : _fallback(fallback) {
+    }
+
+    StaticServiceLocator(const StaticServiceLocator&) = delete;
+    StaticServiceLocator& operator=(const StaticServiceLocator&) = delete;
+
+    // Resolve an interface, a compile error if there is no binding for it
+    template <class IFace>
+    sptr<IFace> resolve() {
+        return resolvePath<IFace, type_list<>>();
+    }
+
+    // Resolve a StaticSingleton by reference, it lives as long as the StaticServiceLocator
+    template <class IFace>
+    IFace& resolveRef() {
+        typedef binding_of<IFace, type_list<>> binding;
+        static_assert(is_singleton<typename binding::type>::value, "resolveRef requires a StaticSingleton binding");
+        return *get<type_list<>>(static_cast<typename binding::type*>(nullptr), std::get<binding::index::value>(_slots));
+    }
+
+    // Bind every StaticTransient and StaticSingleton into sl, resolving them from here.  This StaticServiceLocator
+    // must outlive sl
+    void exportTo(const sptr<ServiceLocator>& sl) {
+        int expand[] = { 0, (exportBinding(sl, static_cast<TBindings*>(nullptr)), 0)... };
+        (void)expand;
+    }
+};
+
+#endif /* StaticServiceLocator_hpp */
@@ -0,0 +1,229 @@
+/*
+   Copyright 2020 Steve Fillingham
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Resolves from 1..N threads at once against shared Singletons, transients and child locators, printing the
+// throughput at each thread count as 1 JSON object per line
+//
+// {"benchmark":"singleton","threads":4,"ops_per_sec":21000000,"scaling":3.61}
+//
+// scaling is the throughput relative to 1 thread.  Before the benchmarks a stress pass races first resolves,
+// eager bindings and child locators across the threads and checks the results, build with make tsan to run it
+// under ThreadSanitizer.
+//
+// Usage: contention [max threads] [seconds per run]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ServiceLocator.hpp"
+
+class IFoo {
+public:
+    virtual ~IFoo() {
+    }
+
+    virtual int value() const = 0;
+};
+
+class Foo : public IFoo {
+public:
+    int value() const override {
+        return 1;
+    }
+};
+
+// Counts its constructions, a Singleton must only ever be constructed once
+class Counted : public IFoo {
+public:
+    static std::atomic<int> constructed;
+
+    Counted() {
+        constructed++;
+    }
+
+    int value() const override {
+        return 2;
+    }
+};
+
+std::atomic<int> Counted::constructed(0);
+
+class Bar {
+private:
+    sptr<IFoo> _foo;
+    sptr<IFoo> _singleton;
+
+public:
+    Bar(const SLContext_sptr& slc) : _foo(slc->resolve<IFoo>()), _singleton(slc->resolve<IFoo>("Singleton")) {
+    }
+
+    int value() const {
+        return _foo->value() + _singleton->value();
+    }
+};
+
+// Runs fn(thread index) on threads threads, started together
+static void runThreads(int threads, const std::function<void(int)>& fn) {
+    std::atomic<int> waiting(threads);
+    std::vector<std::thread> running;
+    for(int t = 0; t < threads; t++) {
+        running.push_back(std::thread([&waiting, &fn, t] () {
+            waiting--;
+            while(waiting.load() > 0) {
+                std::this_thread::yield();
+            }
+            fn(t);
+        }));
+    }
+    for(auto& thread : running) {
+        thread.join();
+    }
+}
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        std::fprintf(stderr, "stress check failed: %s\n", what);
+        std::exit(1);
+    }
+}
+
+static void bindAll(const sptr<ServiceLocator>& sl) {
+    sl->bind<IFoo>().toNoDependancy<Foo>();
+    sl->bind<IFoo>("Singleton").toNoDependancy<Counted>().asSingleton();
+    sl->bind<Bar>().toSelf();
+}
+
+// Races the 1st resolve of Singletons, eager bindings, child locators and resolveAll
+static void stress(int threads, int rounds) {
+    for(int round = 0; round < rounds; round++) {
+        Counted::constructed = 0;
+        auto sl = ServiceLocator::create();
+        bindAll(sl);
+        sl->bind<IFoo>("Eager").toNoDependancy<Foo>().asSingleton().eagerly();
+        std::vector<const IFoo*> singletons(threads);
+        std::vector<const IFoo*> eagers(threads);
+
+        runThreads(threads, [&sl, &singletons, &eagers] (int t) {
+            auto slc = sl->getContext();
+            singletons[t] = slc->resolve<IFoo>("Singleton").get();
+            eagers[t] = slc->resolve<IFoo>("Eager").get();
+
+            auto child = sl->enter();
+            child->bind<IFoo>().toNoDependancy<Counted>();
+            auto bar = child->getContext()->resolve<Bar>();
+            check(bar->value() == 4, "child binding overrides parent");
+
+            std::vector<sptr<IFoo>> all;
+            slc->resolveAll<IFoo>(&all);
+            check(all.size() == 3, "resolveAll");
+            check(sl->getContext()->resolveAllShared<IFoo>()->size() == 3, "resolveAllShared");
+        });
+
+        for(int t = 0; t < threads; t++) {
+            check(singletons[t] == singletons[0], "1 Singleton instance");
+            check(eagers[t] == eagers[0], "1 eager Singleton instance");
+        }
+        // The Singleton plus 1 child binding per thread
+        check(Counted::constructed.load() == threads + 1, "Singleton constructed once");
+    }
+}
+
+// Each thread resolves with fn(thread index) for seconds, returns the total resolves per second
+static double throughput(int threads, double seconds, const std::function<void(int)>& fn) {
+    std::atomic<bool> stop(false);
+    std::vector<std::uint64_t> counts(threads);
+    auto start = std::chrono::steady_clock::now();
+    std::thread timer([&stop, seconds] () {
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        stop = true;
+    });
+    runThreads(threads, [&stop, &counts, &fn] (int t) {
+        std::uint64_t count = 0;
+        while(!stop.load(std::memory_order_relaxed)) {
+            fn(t);
+            count++;
+        }
+        counts[t] = count;
+    });
+    timer.join();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::uint64_t total = 0;
+    for(auto count : counts) {
+        total += count;
+    }
+    return total / elapsed;
+}
+
+// Powers of two, ending at maxThreads even when it isn't one
+static int nextThreads(int threads, int maxThreads) {
+    return threads < maxThreads && threads * 2 > maxThreads ? maxThreads : threads * 2;
+}
+
+static void curve(const char* name, int maxThreads, double seconds, const std::function<void(int)>& fn) {
+    double single = 0;
+    for(int threads = 1; threads <= maxThreads; threads = nextThreads(threads, maxThreads)) {
+        auto opsPerSec = throughput(threads, seconds, fn);
+        if (threads == 1) {
+            single = opsPerSec;
+        }
+        std::printf("{\"benchmark\":\"%s\",\"threads\":%d,\"ops_per_sec\":%.0f,\"scaling\":%.2f}\n", name, threads, opsPerSec, opsPerSec / single);
+        std::fflush(stdout);
+    }
+}
+
+int main(int argc, const char * argv[]) {
+    int maxThreads = argc > 1 ? std::atoi(argv[1]) : (int)std::max(1u, std::thread::hardware_concurrency());
+    double seconds = argc > 2 ? std::atof(argv[2]) : 0.5;
+
+    stress(maxThreads, 50);
+
+    auto sl = ServiceLocator::create();
+    bindAll(sl);
+    auto slc = sl->getContext();
+    auto shared = sl->enter();
+    shared->bind<IFoo>("Child").toNoDependancy<Foo>();
+    auto sharedSlc = shared->getContext();
+
+    curve("singleton", maxThreads, seconds, [&slc] (int) {
+        slc->resolve<IFoo>("Singleton");
+    });
+
+    curve("transient", maxThreads, seconds, [&slc] (int) {
+        slc->resolve<IFoo>();
+    });
+
+    curve("transient_with_dependencies", maxThreads, seconds, [&slc] (int) {
+        slc->resolve<Bar>();
+    });
+
+    // Every thread resolves through 1 child locator
+    curve("shared_child", maxThreads, seconds, [&sharedSlc] (int) {
+        sharedSlc->resolve<IFoo>("Singleton");
+    });
+
+    // Every resolve is from a new child locator, as per request scopes
+    curve("child_per_resolve", maxThreads, seconds, [&sl] (int) {
+        auto child = sl->enter();
+        child->getContext()->resolve<Bar>();
+    });
+
+    return 0;
+}
@@ -0,0 +1,286 @@
+/*
+   Copyright 2020 Steve Fillingham
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Micro benchmarks of the resolve hot paths.  Each benchmark prints 1 JSON object per line
+//
+// {"benchmark":"resolve_unnamed","iterations":4194304,"ns_per_op":41.2,"allocs_per_op":3}
+//
+// Usage: benchmarks [filter] [min seconds per benchmark], only benchmarks whose name contains filter are run
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "ServiceLocator.hpp"
+
+// Every allocation made by the process is counted
+static std::atomic<std::uint64_t> allocations(0);
+
+SERVICELOCATOR_DEFINE_COUNTING_NEW_DELETE(allocations.fetch_add(1, std::memory_order_relaxed))
+
+// Results are written here so the optimizer can't drop the work
+static volatile std::uintptr_t sink;
+
+template <class T>
+void consume(const sptr<T>& ptr) {
+    sink = sink + reinterpret_cast<std::uintptr_t>(ptr.get());
+}
+
+class IFoo {
+public:
+    virtual ~IFoo() {
+    }
+
+    virtual int value() const = 0;
+};
+
+class Foo : public IFoo {
+public:
+    int value() const override {
+        return 1;
+    }
+};
+
+// Level<N> depends on Level<N - 1>, resolving Level<N> constructs N + 1 instances
+template <int N>
+class Level {
+private:
+    sptr<Level<N - 1>> _next;
+
+public:
+    Level(const SLContext_sptr& slc) : _next(slc->resolve<Level<N - 1>>()) {
+    }
+};
+
+template <>
+class Level<0> {
+public:
+    Level(const SLContext_sptr&) {
+    }
+};
+
+template <int N>
+struct bind_levels {
+    static void bind(const sptr<ServiceLocator>& sl) {
+        sl->bind<Level<N>>().toSelf();
+        bind_levels<N - 1>::bind(sl);
+    }
+};
+
+template <>
+struct bind_levels<0> {
+    static void bind(const sptr<ServiceLocator>& sl) {
+        sl->bind<Level<0>>().toSelf();
+    }
+};
+
+class Autowired {
+private:
+    sptr<IFoo> _foo;
+
+public:
+    Autowired(sptr<IFoo> foo) : _foo(foo) {
+    }
+};
+
+class Benchmarks {
+private:
+    const char* _filter;
+    double _minSeconds;
+
+public:
+    Benchmarks(const char* filter, double minSeconds) : _filter(filter), _minSeconds(minSeconds) {
+    }
+
+    // Runs fn(iterations) with doubling iterations until it takes at least _minSeconds, then reports that run
+    template <class Fn>
+    void run(const char* name, Fn fn) {
+        if (_filter != nullptr && std::strstr(name, _filter) == nullptr) {
+            return;
+        }
+
+        std::uint64_t iterations = 1;
+        for(;;) {
+            auto allocationsBefore = allocations.load();
+            auto start = std::chrono::steady_clock::now();
+            fn(iterations);
+            auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            auto allocated = allocations.load() - allocationsBefore;
+
+            if (elapsed >= _minSeconds || iterations >= (std::uint64_t(1) << 40)) {
+                std::printf("{\"benchmark\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f}\n", name, (unsigned long long)iterations, elapsed * 1e9 / iterations, double(allocated) / iterations);
+                std::fflush(stdout);
+                return;
+            }
+            iterations *= 2;
+        }
+    }
+};
+
+int main(int argc, const char * argv[]) {
+    Benchmarks benchmarks(argc > 1 ? argv[1] : nullptr, argc > 2 ? std::atof(argv[2]) : 0.2);
+
+    auto sl = ServiceLocator::create();
+    sl->bind<IFoo>().toNoDependancy<Foo>();
+    sl->bind<IFoo>("Named").toNoDependancy<Foo>();
+    sl->bind<IFoo>("Singleton").toNoDependancy<Foo>().asSingleton();
+    sl->bind<IFoo>("Alias").alias("Singleton");
+    sl->bind<Foo>("Factory").toSelf([] (const SLContext_sptr&) {
+        return make_sptr<Foo>();
+    });
+    for(int i = 0; i < 8; i++) {
+        sl->bind<IFoo>("All" + std::to_string(i)).toNoDependancy<Foo>();
+    }
+    bind_levels<8>::bind(sl);
+    sl->bind<Autowired>().toSelfAutowired<sptr<IFoo>>();
+    auto slc = sl->getContext();
+
+    benchmarks.run("resolve_unnamed", [&slc] (std::uint64_t n) {
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(slc->resolve<IFoo>());
+        }
+    });
+
+    benchmarks.run("resolve_named", [&slc] (std::uint64_t n) {
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(slc->resolve<IFoo>("Named"));
+        }
+    });
+
+    // A factory lambda held in place by the binding
+    benchmarks.run("resolve_factory", [&slc] (std::uint64_t n) {
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(slc->resolve<Foo>("Factory"));
+        }
+    });
+    
+    benchmarks.run("resolve_singleton_hit", [&slc] (std::uint64_t n) {
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(slc->resolve<IFoo>("Singleton"));
+        }
+    });
+
+    benchmarks.run("resolve_transient_depth_1", [&slc] (std::uint64_t n) {
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(slc->resolve<Level<1>>());
+        }
+    });
+
+    benchmarks.run("resolve_transient_depth_4", [&slc] (std::uint64_t n) {
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(slc->resolve<Level<4>>());
+        }
+    });
+
+    benchmarks.run("resolve_transient_depth_8", [&slc] (std::uint64_t n) {
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(slc->resolve<Level<8>>());
+        }
+    });
+
+    benchmarks.run("resolve_alias", [&slc] (std::uint64_t n) {
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(slc->resolve<IFoo>("Alias"));
+        }
+    });
+
+    // 12 bindings, 10 transient (the alias resolves the Singleton)
+    benchmarks.run("resolve_all", [&slc] (std::uint64_t n) {
+        std::vector<sptr<IFoo>> all;
+        for(std::uint64_t i = 0; i < n; i++) {
+            all.clear();
+            slc->resolveAll<IFoo>(&all);
+            consume(all.front());
+        }
+    });
+
+    benchmarks.run("provider_call", [&slc] (std::uint64_t n) {
+        auto provider = slc->provider<IFoo>();
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(provider("Named"));
+        }
+    });
+
+    benchmarks.run("factory_call", [&sl] (std::uint64_t n) {
+        auto factory = sl->factory<IFoo>("Named");
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(factory());
+        }
+    });
+
+    benchmarks.run("plan_execute_depth_8", [&sl] (std::uint64_t n) {
+        auto plan = sl->compilePlan<Level<8>>();
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(plan());
+        }
+    });
+
+    // Resolving through 8 child locators, the binding is in the root
+    benchmarks.run("resolve_enter_chain_8", [&sl] (std::uint64_t n) {
+        auto child = sl;
+        for(int depth = 0; depth < 8; depth++) {
+            child = child->enter();
+        }
+        auto childSlc = child->getContext();
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(childSlc->resolve<IFoo>("Named"));
+        }
+    });
+
+    benchmarks.run("resolve_autowired", [&slc] (std::uint64_t n) {
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(slc->resolve<Autowired>());
+        }
+    });
+    
+    // A child locator per request binding its own services, the autowired argument's cached binding is shared by
+    // every child (compare with enter_bind)
+    benchmarks.run("resolve_autowired_child_per_request", [&sl] (std::uint64_t n) {
+        for(std::uint64_t i = 0; i < n; i++) {
+            auto child = sl->enter();
+            child->bind<Foo>().toSelfNoDependancy();
+            consume(child->getContext()->resolve<Autowired>());
+        }
+    });
+    
+    benchmarks.run("enter_bind", [&sl] (std::uint64_t n) {
+        for(std::uint64_t i = 0; i < n; i++) {
+            auto child = sl->enter();
+            child->bind<Foo>().toSelfNoDependancy();
+            consume(child->getContext());
+        }
+    });
+    
+    benchmarks.run("enter", [&sl] (std::uint64_t n) {
+        for(std::uint64_t i = 0; i < n; i++) {
+            consume(sl->enter());
+        }
+    });
+
+    // A child with 8 eager Singletons, created on its 1st getContext()
+    benchmarks.run("enter_eager_8_get_context", [&sl] (std::uint64_t n) {
+        for(std::uint64_t i = 0; i < n; i++) {
+            auto child = sl->enter();
+            for(int eager = 0; eager < 8; eager++) {
+                child->bind<IFoo>("Eager" + std::to_string(eager)).toNoDependancy<Foo>().asSingleton().eagerly();
+            }
+            consume(child->getContext());
+        }
+    });
+
+    return 0;
+}
@@ -2,7 +2,21 @@
 #include <catch.hpp>
 
 #include <vector>
+// All the opt-in instrumentation is tested, unless SERVICELOCATOR_TEST_DEFAULT_BUILD is defined to test the build
+// without any (see makefile)
+#ifndef SERVICELOCATOR_TEST_DEFAULT_BUILD
+#define SERVICELOCATOR_COUNT_ALLOCATIONS
+#define SERVICELOCATOR_METRICS
+#define SERVICELOCATOR_TRACE
+#define SERVICELOCATOR_STARTUP_PROFILE
+#define SERVICELOCATOR_COUNT_INSTANCES
+#endif
 #include "ServiceLocator.hpp"
+#include "StaticServiceLocator.hpp"
+
+#ifdef SERVICELOCATOR_COUNT_ALLOCATIONS
+SERVICELOCATOR_DEFINE_ALLOCATION_HOOKS
+#endif
 
 class ITest {
 public:
@@ -18,6 +32,30 @@ public:
     virtual std::string getIt() = 0;
 };
 
+#ifdef SERVICELOCATOR_TRACE
+// Records TraceEvents as "begin/end Kind name depth", and keeps the ended events themselves
+class TestTraceSink : public ServiceLocator::TraceSink {
+public:
+    std::vector<std::string> events;
+    std::vector<ServiceLocator::TraceEvent> ended;
+
+    std::string describe(const ServiceLocator::TraceEvent& event) {
+        auto kind = event.kind == ServiceLocator::TraceEvent::Kind::Resolve ? "Resolve " : "Construct ";
+        auto lifetime = !event.bound ? "" : event.lifetime == ServiceLocator::Lifetime::Singleton ? " Singleton" : event.lifetime == ServiceLocator::Lifetime::Instance ? " Instance" : " Transient";
+        return kind + event.name + " " + std::to_string(event.depth) + lifetime;
+    }
+
+    void begin(const ServiceLocator::TraceEvent& event) override {
+        events.push_back("begin " + describe(event));
+    }
+
+    void end(const ServiceLocator::TraceEvent& event, std::uint64_t nanos) override {
+        events.push_back("end " + describe(event));
+        ended.push_back(event);
+    }
+};
+#endif
+
 class TransientDestructor {
 public:
     TransientDestructor(SLContext_sptr slc) {
@@ -73,6 +111,51 @@ public:
     }
 };
 
+class TestAutowired {
+public:
+    std::shared_ptr<ITest> test;
+    std::unique_ptr<TestNoSL> unique;
+    
+    TestAutowired(std::shared_ptr<ITest> t, std::unique_ptr<TestNoSL> u) : test(t), unique(std::move(u)) {
+    }
+};
+
+class TestLazy {
+public:
+    ServiceLocator::Lazy<ITest> test;
+    
+    TestLazy(ServiceLocator::Lazy<ITest> t) : test(t) {
+    }
+};
+
+class IStaticFoo {
+public:
+    virtual ~IStaticFoo() {
+    }
+    
+    virtual std::string getIt() = 0;
+};
+
+class StaticFoo : public IStaticFoo {
+public:
+    std::shared_ptr<TestNoSL> external;
+    
+    StaticFoo(std::shared_ptr<TestNoSL> e) : external(e) {
+    }
+    
+    std::string getIt() override {
+        return "StaticFoo";
+    }
+};
+
+class StaticBar {
+public:
+    std::shared_ptr<IStaticFoo> foo;
+    
+    StaticBar(std::shared_ptr<IStaticFoo> f) : foo(f) {
+    }
+};
+
 static int TestEagerCount = 0;
 class TestEager {
 public:
@@ -82,6 +165,49 @@ public:
 };
 
 
+static std::vector<std::string> TeardownOrder;
+class TeardownB {
+public:
+    TeardownB() {
+    }
+    
+    ~TeardownB() {
+        TeardownOrder.push_back("B");
+    }
+};
+
+class TeardownA {
+public:
+    TeardownA(SLContext_sptr slc) {
+        // Uses but does not hold onto B, B must still outlive A
+        slc->resolve<TeardownB>();
+    }
+    
+    ~TeardownA() {
+        TeardownOrder.push_back("A");
+    }
+};
+
+class CountingResource : public ServiceLocator::MemoryResource {
+public:
+    int allocations = 0;
+    int deallocations = 0;
+    
+    void* allocate(std::size_t bytes, std::size_t alignment) override {
+        allocations++;
+        return ::operator new(bytes);
+    }
+    
+    void deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+        deallocations++;
+        ::operator delete(p);
+    }
+};
+
+struct alignas(64) TestOverAligned {
+    char data[64];
+};
+
 class TestAModule : public ServiceLocator::Module {
 public:
     void load() override {
@@ -97,6 +223,103 @@ public:
 };
 
 
+TEST_CASE( "ServiceLocator MemoryResource", "[servicelocator]" ) {
+    GIVEN("a CountingResource") {
+        CountingResource resource;
+        
+        SECTION("Bindings, Contexts and instances allocate from resource") {
+            {
+                auto sl = ServiceLocator::create(&resource, true);
+                sl->bind<ITest>().to<TestA>();
+                auto slc = sl->getContext();
+                
+                auto before = resource.allocations;
+                auto a = slc->resolve<ITest>();
+                
+                REQUIRE(a->getIt() == "TestA");
+                // 1 Context + 1 instance
+                REQUIRE(resource.allocations == before + 2);
+            }
+            REQUIRE(resource.allocations == resource.deallocations);
+        }
+        
+        SECTION("Instances use the global heap unless requested") {
+            auto sl = ServiceLocator::create(&resource);
+            sl->bind<ITest>().to<TestA>();
+            auto slc = sl->getContext();
+            
+            auto before = resource.allocations;
+            auto a = slc->resolve<ITest>();
+            
+            REQUIRE(resource.allocations == before + 1);
+        }
+        
+        SECTION("Over aligned instances from the global heap") {
+            auto sl = ServiceLocator::create(ServiceLocator::defaultResource(), true);
+            sl->bind<TestOverAligned>().toSelfNoDependancy();
+            auto slc = sl->getContext();
+            
+            for(int i = 0; i < 4; i++) {
+                auto instance = slc->resolve<TestOverAligned>();
+                REQUIRE(reinterpret_cast<std::uintptr_t>(instance.get()) % alignof(TestOverAligned) == 0);
+            }
+            REQUIRE_THROWS_AS(slc->resolveUnique<TestOverAligned>(), BindingIssueException);
+        }
+        
+        SECTION("Child locator with MonotonicBufferResource") {
+            auto sl = ServiceLocator::create(&resource);
+            sl->bind<ITest>().to<TestA>();
+            
+            char buffer[4096];
+            ServiceLocator::MonotonicBufferResource monotonic(buffer, sizeof(buffer), &resource);
+            {
+                auto child = sl->enter(&monotonic, true);
+                child->bind<TestC>().toSelf();
+                
+                auto before = resource.allocations;
+                auto c = child->getContext()->resolve<TestC>();
+                
+                REQUIRE(c->test->getIt() == "TestA");
+                REQUIRE(resource.allocations == before);
+            }
+        }
+    }
+}
+
+TEST_CASE( "StaticServiceLocator", "[servicelocator]" ) {
+    GIVEN("a StaticServiceLocator with a runtime fallback") {
+        auto sl = ServiceLocator::create();
+        sl->bind<TestNoSL>().toSelfNoDependancy().asSingleton();
+        
+        StaticServiceLocator<
+            StaticSingleton<IStaticFoo, StaticFoo, TestNoSL>,
+            StaticTransient<StaticBar, StaticBar, IStaticFoo>,
+            StaticExternal<TestNoSL>
+        > ssl(sl);
+        
+        SECTION("Static resolve") {
+            auto bar1 = ssl.resolve<StaticBar>();
+            auto bar2 = ssl.resolve<StaticBar>();
+            
+            REQUIRE(bar1 != bar2);
+            REQUIRE(bar1->foo == bar2->foo);
+            REQUIRE(&ssl.resolveRef<IStaticFoo>() == bar1->foo.get());
+            REQUIRE(bar1->foo->getIt() == "StaticFoo");
+            REQUIRE(std::static_pointer_cast<StaticFoo>(bar1->foo)->external == sl->getContext()->resolve<TestNoSL>());
+        }
+        
+        SECTION("Exported to the runtime ServiceLocator") {
+            ssl.exportTo(sl);
+            auto slc = sl->getContext();
+            
+            auto bar = slc->resolve<StaticBar>();
+            
+            REQUIRE(bar->foo == ssl.resolve<IStaticFoo>());
+            REQUIRE(&slc->resolveRef<IStaticFoo>() == bar->foo.get());
+        }
+    }
+}
+
 TEST_CASE( "ServiceLocator", "[servicelocator]" ) {
     GIVEN("a ServiceLocator") {
         auto sl = ServiceLocator::create();
@@ -214,6 +437,13 @@ TEST_CASE( "ServiceLocator", "[servicelocator]" ) {
             REQUIRE_THROWS((sl->bind<ITest>().to<TestB>()));
         }
         
+        SECTION("Binding with no to clause throws on resolve") {
+            sl->bind<TestNoSL>();
+            auto slc = sl->getContext();
+            
+            REQUIRE_THROWS_AS(slc->resolve<TestNoSL>(), std::bad_function_call);
+        }
+        
         SECTION("Named binding") {
             sl->bind<ITest>("X").to<TestA>();
             sl->bind<ITest>("Y").to<TestB>();
@@ -261,6 +491,546 @@ TEST_CASE( "ServiceLocator", "[servicelocator]" ) {
             REQUIRE(a->contextPath == "ITest->");
         }
 
+        SECTION("Binding to self function") {
+            sl->bind<TestC>().toSelf([] (SLContext_sptr slc) { return make_sptr<TestC>(slc); });
+            sl->bind<TestNoSL>().toSelf([] (SLContext_sptr slc) { return new TestNoSL(); });
+            auto slc = sl->getContext();
+
+            auto c = slc->resolve<TestC>();
+            auto n = slc->resolve<TestNoSL>();
+            
+            REQUIRE(c->getIt() == "TestC");
+            REQUIRE(n->getIt() == "TestNoSL");
+            REQUIRE(c.use_count() == 1);
+        }
+
+        SECTION("Binding to function with large capture") {
+            // Too big to be held inline by the binding, and taking the Context by reference
+            std::string names[4] = { "A", "B", "C", "D" };
+            sl->bind<TestNoSL>().toSelf([names] (const SLContext_sptr& slc) { return new TestNoSL(); });
+            sl->bind<ITest>().to<TestA>([names] (const SLContext_sptr& slc) { return make_sptr<TestA>(slc); });
+            auto slc = sl->getContext();
+
+            auto copied = std::string();
+            slc->afterResolve([names, &copied] (const SLContext_sptr& slc) { copied = names[3]; });
+
+            REQUIRE(slc->resolve<TestNoSL>()->getIt() == "TestNoSL");
+            REQUIRE(slc->resolveUnique<TestNoSL>()->getIt() == "TestNoSL");
+            REQUIRE(slc->resolve<ITest>()->getIt() == "TestA");
+            REQUIRE(copied == "D");
+        }
+
+        SECTION("Resolve unique transient") {
+            sl->bind<TransientDestructor>().toSelf();
+            sl->bind<TestNoSL>().toUnique<TestNoSL>([] (SLContext_sptr slc) { return uptr<TestNoSL>(new TestNoSL()); });
+            sl->bind<ITest>().to<TestA>();
+            auto slc = sl->getContext();
+
+            int destructCount = 0;
+            {
+                std::unique_ptr<TransientDestructor> a = slc->resolveUnique<TransientDestructor>();
+                
+                a->destructCount = &destructCount;
+            }
+            REQUIRE(destructCount == 1);
+            
+            REQUIRE(slc->resolveUnique<TestNoSL>()->getIt() == "TestNoSL");
+            REQUIRE(slc->resolve<TestNoSL>()->getIt() == "TestNoSL");
+            
+            // ITest has no virtual destructor so cannot be uniquely owned as an ITest
+            REQUIRE_THROWS_AS(slc->resolveUnique<ITest>(), BindingIssueException);
+        }
+
+        SECTION("Resolve unique singleton throws") {
+            sl->bind<TransientDestructor>().toSelf().asSingleton();
+            auto slc = sl->getContext();
+
+            REQUIRE_THROWS_AS(slc->resolveUnique<TransientDestructor>(), BindingIssueException);
+        }
+
+        SECTION("Resolve by reference") {
+            auto sa = std::shared_ptr<TestNoSL>(new TestNoSL());
+            sl->bind<TestNoSL>().toInstance(sa);
+            sl->bind<ITest>().to<TestA>().asSingleton();
+            sl->bind<ITest>("transient").to<TestB>();
+            auto slc = sl->getContext();
+
+            TestNoSL& n = slc->resolveRef<TestNoSL>();
+            ITest& a = slc->resolveRef<ITest>();
+            
+            REQUIRE(&n == sa.get());
+            REQUIRE(&a == slc->resolve<ITest>().get());
+            REQUIRE(&a == &slc->resolveRef<ITest>());
+            REQUIRE(a.getIt() == "TestA");
+            REQUIRE_THROWS_AS(slc->resolveRef<ITest>("transient"), BindingIssueException);
+        }
+
+        SECTION("Singletons released in reverse dependency order") {
+            TeardownOrder.clear();
+            sl->bind<TeardownB>().toSelfNoDependancy().asSingleton();
+            sl->bind<TeardownA>().toSelf().asSingleton();
+            sl->getContext()->resolve<TeardownA>();
+            
+            sl->shutdown();
+            
+            REQUIRE(TeardownOrder == std::vector<std::string>({ "A", "B" }));
+        }
+
+        SECTION("Singletons released in parallel waves") {
+            TeardownOrder.clear();
+            sl->bind<TeardownB>().toSelfNoDependancy().asSingleton();
+            sl->bind<TeardownA>().toSelf().asSingleton();
+            sl->getContext()->resolve<TeardownA>();
+            
+            sl->shutdown(ServiceLocator::threadExecutor());
+            
+            REQUIRE(TeardownOrder == std::vector<std::string>({ "A", "B" }));
+        }
+
+        SECTION("Singletons in a dependency cycle are released") {
+            // Failed constructions leave A -> B and B -> A recorded before both are created
+            int attemptsA = 0;
+            sl->bind<TestNoSL>("A").toSelf([&attemptsA] (const SLContext_sptr& slc) -> TestNoSL* {
+                attemptsA++;
+                if (attemptsA == 1) {
+                    throw std::runtime_error("A failed");
+                }
+                if (attemptsA == 2) {
+                    slc->resolve<TestNoSL>("B");
+                }
+                return new TestNoSL();
+            }).asSingleton();
+            sl->bind<TestNoSL>("B").toSelf([] (const SLContext_sptr& slc) {
+                slc->resolve<TestNoSL>("A");
+                return new TestNoSL();
+            }).asSingleton();
+            auto slc = sl->getContext();
+            
+            REQUIRE_THROWS(slc->resolve<TestNoSL>("B"));
+            REQUIRE_THROWS(slc->resolve<TestNoSL>("A"));
+            std::weak_ptr<TestNoSL> b = slc->resolve<TestNoSL>("B");
+            std::weak_ptr<TestNoSL> a = slc->resolve<TestNoSL>("A");
+            REQUIRE(!a.expired());
+            
+            sl->shutdown(ServiceLocator::threadExecutor());
+            
+            REQUIRE(a.expired());
+            REQUIRE(b.expired());
+        }
+
+        SECTION("Module loading does not leak the ServiceLocator") {
+            sl->modules().add<TestAModule>();
+            std::weak_ptr<ServiceLocator> weak = sl;
+            sl = nullptr;
+            
+            REQUIRE(weak.expired());
+        }
+
+        SECTION("Autowired constructor") {
+            sl->bind<ITest>().to<TestA>();
+            sl->bind<TestNoSL>().toSelfNoDependancy();
+            sl->bind<TestAutowired>().toSelfAutowired<std::shared_ptr<ITest>, std::unique_ptr<TestNoSL>>();
+            auto slc = sl->getContext();
+
+            auto a = slc->resolve<TestAutowired>();
+            auto b = slc->resolve<TestAutowired>();
+            
+            REQUIRE(a->test->getIt() == "TestA");
+            REQUIRE(a->unique->getIt() == "TestNoSL");
+            REQUIRE(a->test->contextPath == "ITest->TestAutowired->");
+            REQUIRE(a->test != b->test);
+            
+            // A child override is picked up even though the parent's binding was cached
+            auto child = sl->enter();
+            child->bind<ITest>().to<TestB>();
+            REQUIRE(child->getContext()->resolve<TestAutowired>()->test->getIt() == "TestB");
+            REQUIRE(slc->resolve<TestAutowired>()->test->getIt() == "TestA");
+            
+            // Children without bindings of ITest share the cached binding of the locator they resolve it from
+            for(int request = 0; request < 3; request++) {
+                auto perRequest = sl->enter();
+                perRequest->bind<TestC>().toSelf();
+                REQUIRE(perRequest->getContext()->resolve<TestAutowired>()->test->getIt() == "TestA");
+                REQUIRE(child->enter()->getContext()->resolve<TestAutowired>()->test->getIt() == "TestB");
+            }
+            
+            // Repeat constructions from one locator skip the lookup, a later binding only forces a fresh one
+            REQUIRE(slc->resolve<TestAutowired>()->test->getIt() == "TestA");
+            REQUIRE(slc->resolve<TestAutowired>()->test->getIt() == "TestA");
+            sl->bind<ITest>("Other").to<TestB>();
+            REQUIRE(slc->resolve<TestAutowired>()->test->getIt() == "TestA");
+        }
+
+        SECTION("Lazy resolve") {
+            sl->bind<ITest>().to<TestA>();
+            sl->bind<TestLazy>().toSelfAutowired<ServiceLocator::Lazy<ITest>>();
+            auto slc = sl->getContext();
+
+            auto l = slc->resolve<TestLazy>();
+            REQUIRE(!l->test.isCreated());
+            REQUIRE(l->test->getIt() == "TestA");
+            REQUIRE(l->test.isCreated());
+            REQUIRE(l->test.get() == l->test.get());
+
+            auto copy = slc->resolveLazy<ITest>();
+            REQUIRE(copy.get() != l->test.get());
+            REQUIRE_THROWS_AS(slc->resolveLazy<ITest>("missing"), UnableToResolveException);
+
+            ServiceLocator::Lazy<ITest> empty;
+            REQUIRE(!empty);
+            REQUIRE_THROWS_AS(empty.get(), UnableToResolveException);
+
+            // A factory dereferencing the Lazy it is creating for
+            auto self = std::make_shared<ServiceLocator::Lazy<TestNoSL>>();
+            sl->bind<TestNoSL>().toSelf([self] (const SLContext_sptr& slc) {
+                self->get();
+                return new TestNoSL();
+            });
+            *self = slc->resolveLazy<TestNoSL>();
+            REQUIRE_THROWS_AS(self->get(), RecursiveResolveException);
+            REQUIRE(!self->isCreated());
+            *self = ServiceLocator::Lazy<TestNoSL>();
+
+            // A Lazy doesn't keep its ServiceLocator alive, so a Singleton holding one is released with it
+            auto child = sl->enter();
+            child->bind<TestLazy>().toSelfAutowired<ServiceLocator::Lazy<ITest>>().asSingleton();
+            std::weak_ptr<TestLazy> singleton = child->getContext()->resolve<TestLazy>();
+            auto orphan = child->getContext()->resolveLazy<ITest>();
+            child.reset();
+            REQUIRE(singleton.expired());
+            REQUIRE_THROWS_AS(orphan.get(), UnableToResolveException);
+            REQUIRE(l->test->getIt() == "TestA");
+        }
+
+        SECTION("Resolution plan") {
+            sl->bind<ITest>().to<TestA>().asSingleton();
+            sl->bind<TestNoSL>().toSelfNoDependancy();
+            sl->bind<TestAutowired>().toSelfAutowired<std::shared_ptr<ITest>, std::unique_ptr<TestNoSL>>();
+            sl->bind<TestC>().toSelf();
+            auto child = sl->enter();
+            auto plan = child->compilePlan<TestAutowired>();
+
+            // The 1st execute records, the 2nd replays skipping the already created Singleton
+            auto a = plan.execute();
+            auto b = plan.execute();
+
+            REQUIRE(a != b);
+            REQUIRE(a->test == b->test);
+            REQUIRE(b->unique->getIt() == "TestNoSL");
+            REQUIRE(a->test->contextPath == "ITest->TestAutowired->");
+
+            // TestC's tryResolve is not part of the plan
+            auto cplan = child->compilePlan<TestC>();
+            REQUIRE(cplan.execute()->test == a->test);
+            REQUIRE(cplan.execute()->test == a->test);
+
+            // A new binding invalidates the plan
+            child->bind<ITest>().to<TestB>();
+            REQUIRE(plan.execute()->test->getIt() == "TestB");
+            REQUIRE(plan.execute()->test->getIt() == "TestB");
+            REQUIRE(sl->compilePlan<TestAutowired>()()->test->getIt() == "TestA");
+        }
+
+        SECTION("Resolution plan falls back to the parent as resolve does") {
+            auto sa = std::shared_ptr<TestNoSL>(new TestNoSL());
+            sl->bind<TestNoSL>().toInstance(sa);
+            auto child = sl->enter();
+            bool create = false;
+            child->bind<TestNoSL>().toSelf([&create] (const SLContext_sptr& slc) {
+                return create ? new TestNoSL() : nullptr;
+            });
+            auto plan = child->compilePlan<TestNoSL>();
+
+            // Recorded while the child's binding resolves to nullptr, replayed once it no longer does
+            REQUIRE(plan.execute() == sa);
+            create = true;
+            REQUIRE(plan.execute() != sa);
+            REQUIRE(child->getContext()->resolve<TestNoSL>() != sa);
+            create = false;
+            REQUIRE(plan.execute() == sa);
+        }
+
+        SECTION("Aliases") {
+            sl->bind<TestA>().toSelf().asSingleton();
+            sl->bind<ITest>().alias<TestA>();
+            sl->bind<ITest>("X").alias("");
+            sl->bind<ITest>("Y").alias("X");
+            auto slc = sl->getContext();
+
+            auto a = slc->resolve<TestA>();
+            REQUIRE(slc->resolve<ITest>() == a);
+            REQUIRE(slc->resolve<ITest>("Y") == a);
+            REQUIRE(slc->resolve<ITest>("Y") == a);
+
+            // A child override is seen through the parent's alias chain
+            auto child = sl->enter();
+            child->bind<ITest>("X").to<TestB>();
+            REQUIRE(child->getContext()->resolve<ITest>("Y")->getIt() == "TestB");
+
+            sl->bind<ITest>("P").alias("Q");
+            sl->bind<ITest>("Q").alias("P");
+            REQUIRE_THROWS_AS(slc->resolve<ITest>("P"), RecursiveResolveException);
+            REQUIRE_THROWS_AS(slc->resolve<ITest>("Q"), RecursiveResolveException);
+
+            // A cycle made by a child is caught though the parent's alias has its target cached
+            auto cycle = sl->enter();
+            cycle->bind<ITest>("X").alias("Y");
+            REQUIRE_THROWS_AS(cycle->getContext()->resolve<ITest>("Y"), RecursiveResolveException);
+            REQUIRE(slc->resolve<ITest>("Y") == a);
+
+            // The aliased binding resolves in place of the alias, through the alias's Context
+            sl->bind<TestB>().toSelf();
+            sl->bind<ITest>("B").alias<TestB>("");
+            REQUIRE(slc->resolve<ITest>("B")->contextPath == "TestB->");
+
+            // A factory resolving its own alias is still caught
+            sl->bind<TestNoSL>("R").toSelf([] (const SLContext_sptr& slc) {
+                slc->resolve<TestNoSL>("S");
+                return new TestNoSL();
+            });
+            sl->bind<TestNoSL>("S").alias("R");
+            REQUIRE_THROWS_AS(slc->resolve<TestNoSL>("S"), RecursiveResolveException);
+            sl->bind<ITest>("Self").alias("Self");
+            REQUIRE_THROWS_AS(slc->resolve<ITest>("Self"), RecursiveResolveException);
+        }
+
+        SECTION("Resolve many") {
+            sl->bind<ITest>().to<TestA>();
+            sl->bind<ITest>("function").to<TestB>([] (SLContext_sptr slc) { return new TestB(slc); });
+            sl->bind<TestNoSL>().toSelfNoDependancy().asSingleton();
+            auto slc = sl->getContext();
+
+            std::vector<std::shared_ptr<ITest>> tests;
+            slc->resolveMany<ITest>(3, &tests);
+            slc->resolveMany<ITest>("function", 2, &tests);
+
+            REQUIRE(tests.size() == 5);
+            REQUIRE(tests[0] != tests[1]);
+            REQUIRE(tests[2]->getIt() == "TestA");
+            REQUIRE(tests[2]->contextPath == "ITest->");
+            REQUIRE(tests[3] != tests[4]);
+            REQUIRE(tests[4]->getIt() == "TestB");
+
+            std::vector<std::shared_ptr<TestNoSL>> singletons;
+            slc->resolveMany<TestNoSL>(2, &singletons);
+            REQUIRE(singletons[0] == singletons[1]);
+
+            // Each instance is destroyed with its own last reference, unless they share 1 allocation
+            sl->bind<TransientDestructor>().toSelf();
+            int destructCount = 0;
+            for(auto sharedAllocation : { false, true }) {
+                std::vector<std::shared_ptr<TransientDestructor>> many;
+                slc->resolveMany<TransientDestructor>(2, &many, sharedAllocation);
+                many[0]->destructCount = &destructCount;
+                many[1]->destructCount = &destructCount;
+                many[0] = nullptr;
+                REQUIRE(destructCount == (sharedAllocation ? 2 : 1));
+                many.clear();
+                REQUIRE(destructCount == (sharedAllocation ? 4 : 2));
+            }
+
+            // A binding resolving to nullptr falls back to the parent
+            auto child = sl->enter();
+            child->bind<TestNoSL>().toSelf([] (const SLContext_sptr& slc) -> TestNoSL* {
+                return nullptr;
+            });
+            std::vector<std::shared_ptr<TestNoSL>> fallback;
+            child->getContext()->resolveMany<TestNoSL>(2, &fallback);
+            REQUIRE(fallback == std::vector<std::shared_ptr<TestNoSL>>({ singletons[0], singletons[0] }));
+        }
+
+        SECTION("Factory") {
+            sl->bind<ITest>("X").to<TestA>();
+            auto child = sl->enter();
+            auto factory = child->factory<ITest>("X");
+
+            auto a = factory();
+            auto b = factory();
+
+            REQUIRE(a != b);
+            REQUIRE(a->getIt() == "TestA");
+
+            child->bind<ITest>("X").to<TestB>();
+            REQUIRE(factory()->getIt() == "TestB");
+            REQUIRE_THROWS_AS(child->factory<ITest>()(), UnableToResolveException);
+
+            // Bindings elsewhere don't change the answer
+            sl->enter()->bind<ITest>("X").to<TestA>();
+            sl->bind<ITest>("Y").to<TestA>();
+            REQUIRE(factory()->getIt() == "TestB");
+
+            // A binding resolving to nullptr falls back to the parent as resolve does
+            auto sa = std::shared_ptr<TestNoSL>(new TestNoSL());
+            sl->bind<TestNoSL>().toInstance(sa);
+            child->bind<TestNoSL>().toSelf([] (const SLContext_sptr& slc) -> TestNoSL* {
+                return nullptr;
+            });
+            REQUIRE(child->factory<TestNoSL>()() == sa);
+        }
+
+#ifdef SERVICELOCATOR_COUNT_ALLOCATIONS
+        SECTION("Allocation counts") {
+            sl->bind<ITest>("A").to<TestA>();
+            sl->bind<ITest>("B").to<TestB>().asSingleton();
+            auto slc = sl->getContext();
+
+            auto countOf = [&sl] (const std::string& name) {
+                for(auto& count : sl->getAllocationCounts()) {
+                    if (count.name == name) {
+                        return count;
+                    }
+                }
+                return ServiceLocator::BindingAllocations { "", "", 0, 0 };
+            };
+
+            REQUIRE(countOf("A").interfaceTypeName == "ITest");
+            REQUIRE(countOf("A").allocations == 0);
+            slc->resolve<ITest>("A");
+            REQUIRE(countOf("A").allocations > 0);
+            REQUIRE(countOf("A").bytes >= sizeof(TestA));
+
+            // Only constructing the Singleton allocates
+            slc->resolve<ITest>("B");
+            auto constructed = countOf("B").allocations;
+            REQUIRE(constructed > 0);
+            slc->resolve<ITest>("B");
+            REQUIRE(countOf("B").allocations == constructed);
+        }
+#endif
+
+#ifdef SERVICELOCATOR_METRICS
+        SECTION("Metrics") {
+            sl->bind<ITest>("A").to<TestA>();
+            sl->bind<ITest>("B").to<TestB>().asSingleton();
+            auto slc = sl->getContext();
+
+            slc->resolve<ITest>("A");
+            slc->resolve<ITest>("A");
+            for(int i = 0; i < 3; i++) {
+                slc->resolve<ITest>("B");
+            }
+            // Including the created Singleton resolveAll hands out directly
+            std::vector<std::shared_ptr<ITest>> all;
+            slc->resolveAll<ITest>(&all);
+            slc->resolveAll<ITest>(&all, ServiceLocator::threadExecutor());
+
+            REQUIRE(sl->getMetrics().size() == 2);
+            for(auto& metrics : sl->getMetrics()) {
+                std::uint64_t histogramTotal = 0;
+                for(auto bucket : metrics.constructionHistogram) {
+                    histogramTotal += bucket;
+                }
+                REQUIRE(histogramTotal == metrics.constructions);
+                if (metrics.name == "A") {
+                    REQUIRE(metrics.resolves == 4);
+                    REQUIRE(metrics.hits == 0);
+                    REQUIRE(metrics.constructions == 4);
+                } else {
+                    REQUIRE(metrics.resolves == 5);
+                    REQUIRE(metrics.hits == 4);
+                    REQUIRE(metrics.constructions == 1);
+                }
+            }
+        }
+
+        SECTION("Dependency graph") {
+            sl->bind<ITest>().to<TestA>().asSingleton();
+            sl->bind<TestC>().toSelf();
+            auto slc = sl->getContext();
+            slc->resolve<TestC>();
+            slc->resolve<TestC>();
+
+            auto json = sl->exportGraphJson();
+            auto testC = json.find("{\"id\":0,\"interface\":\"TestC\"") != std::string::npos ? 0 : 1;
+            auto from = std::to_string(testC);
+            auto to = std::to_string(1 - testC);
+            REQUIRE(json.find("\"lifetime\":\"Singleton\",\"resolves\":2,\"constructions\":1") != std::string::npos);
+            REQUIRE(json.find("\"lifetime\":\"Transient\",\"resolves\":2,\"constructions\":2") != std::string::npos);
+            REQUIRE(json.find("\"edges\":[{\"from\":" + from + ",\"to\":" + to + "}]}") != std::string::npos);
+
+            auto dot = sl->exportGraphDot();
+            REQUIRE(dot.find("digraph ServiceLocator {") == 0);
+            REQUIRE(dot.find("  n" + from + " -> n" + to + ";") != std::string::npos);
+
+            // Dependencies are kept by interface and name, so a parent binding resolving from per request children
+            // keeps 1 edge, to whichever binding the exporting locator resolves
+            for(int i = 0; i < 3; i++) {
+                auto child = sl->enter();
+                child->bind<ITest>().to<TestB>();
+                child->getContext()->resolve<TestC>();
+                auto childJson = child->exportGraphJson();
+                auto childTestC = childJson.find("{\"id\":1,\"interface\":\"TestC\"") != std::string::npos ? "1" : "2";
+                REQUIRE(childJson.find(std::string("\"edges\":[{\"from\":") + childTestC + ",\"to\":0}]}") != std::string::npos);
+            }
+            REQUIRE(sl->exportGraphJson().find("\"edges\":[{\"from\":" + from + ",\"to\":" + to + "}]}") != std::string::npos);
+
+            // Falling back to the parent's binding doesn't make it a dependency of the child's
+            sl->bind<TestNoSL>().toInstance(std::make_shared<TestNoSL>());
+            auto child = sl->enter();
+            child->bind<TestNoSL>().toSelf([] (const SLContext_sptr& slc) -> TestNoSL* {
+                return nullptr;
+            });
+            child->getContext()->resolve<TestNoSL>();
+            REQUIRE(child->exportGraphJson().find("{\"from\":0,") == std::string::npos);
+        }
+#endif
+
+#ifdef SERVICELOCATOR_TRACE
+        SECTION("Tracing") {
+            sl->bind<ITest>("A").to<TestA>();
+            sl->bind<ITest>("B").to<TestB>().asSingleton();
+            auto slc = sl->getContext();
+
+            TestTraceSink sink;
+            ServiceLocator::setTraceSink(&sink);
+            slc->resolve<ITest>("A");
+            slc->resolve<ITest>("B");
+            slc->resolve<ITest>("B");
+            ServiceLocator::setTraceSink(nullptr);
+            slc->resolve<ITest>("A");
+
+            REQUIRE(sink.events == std::vector<std::string>({
+                "begin Resolve A 0",
+                "begin Construct A 0 Transient",
+                "end Construct A 0 Transient",
+                "end Resolve A 0 Transient",
+                "begin Resolve B 0",
+                "begin Construct B 0 Singleton",
+                "end Construct B 0 Singleton",
+                "end Resolve B 0 Singleton",
+                "begin Resolve B 0",
+                "end Resolve B 0 Singleton"
+            }));
+
+            // Events kept past their resolve are still readable, and can be overwritten (eg in a ring buffer)
+            REQUIRE(sink.ended.size() == 5);
+            REQUIRE(sink.ended[0].name == "A");
+            REQUIRE(sink.ended[4].name == "B");
+            sink.ended[0] = sink.ended[4];
+            REQUIRE(sink.describe(sink.ended[0]) == "Resolve B 0 Singleton");
+
+            // Every way of resolving reports its resolve
+            sl->bind<ITest>("C").alias("B");
+            std::vector<std::shared_ptr<ITest>> all;
+            sink.events.clear();
+            ServiceLocator::setTraceSink(&sink);
+            slc->tryResolve<ITest>("A");
+            slc->provider<ITest>()("A");
+            slc->resolveMany<ITest>("A", 2, &all);
+            slc->resolveAll<ITest>(&all);
+            sl->factory<ITest>("A")();
+            slc->resolveLazy<ITest>("A").get();
+            slc->resolve<ITest>("C");
+            ServiceLocator::setTraceSink(nullptr);
+
+            // resolveAll resolves A, B, C and the alias B
+            REQUIRE(std::count(sink.events.begin(), sink.events.end(), "end Resolve A 0 Transient") == 6);
+            REQUIRE(std::count(sink.events.begin(), sink.events.end(), "end Resolve B 1 Singleton") == 2);
+            REQUIRE(std::count(sink.events.begin(), sink.events.end(), "end Resolve C 0 Transient") == 2);
+            REQUIRE(std::count(sink.events.begin(), sink.events.end(), "end Resolve B 0 Singleton") == 1);
+        }
+#endif
+
         SECTION("Nested locator") {
             sl->bind<ITest>().to<TestA>();
             auto slc = sl->getContext();
@@ -293,6 +1063,62 @@ TEST_CASE( "ServiceLocator", "[servicelocator]" ) {
             REQUIRE(c->test == a);
         }
  
+#ifdef SERVICELOCATOR_COUNT_INSTANCES
+        SECTION("Instance counts") {
+            sl->bind<ITest>("A").to<TestA>();
+            sl->bind<ITest>("B").to<TestB>().asSingleton();
+            auto slc = sl->getContext();
+
+            auto countOf = [&sl] (const std::string& name) {
+                for(auto& count : sl->getInstanceCounts()) {
+                    if (count.name == name) {
+                        return count;
+                    }
+                }
+                return ServiceLocator::BindingInstances { "", "", 0, 0, 0 };
+            };
+
+            {
+                auto a1 = slc->resolve<ITest>("A");
+                auto a2 = slc->resolve<ITest>("A");
+                REQUIRE(countOf("A").live == 2);
+                REQUIRE(countOf("A").bytes == 2 * sizeof(TestA));
+            }
+            REQUIRE(countOf("A").live == 0);
+            REQUIRE(countOf("A").bytes == 0);
+            REQUIRE(countOf("A").highWater == 2);
+
+            slc->resolve<ITest>("B");
+            slc->resolve<ITest>("B");
+            REQUIRE(countOf("B").live == 1);
+            sl->shutdown();
+            REQUIRE(countOf("B").live == 0);
+        }
+#endif
+
+#ifdef SERVICELOCATOR_STARTUP_PROFILE
+        SECTION("Startup profile") {
+            sl->modules().add<TestAModule>();
+            sl->bind<TestC>().toSelf().asSingleton().eagerly();
+            sl->getContext();
+
+            typedef ServiceLocator::StartupProfileEntry::Kind Kind;
+            auto profile = sl->getStartupProfile();
+            REQUIRE(profile.size() == 4);
+            REQUIRE((profile[0].kind == Kind::Module && profile[0].name == "TestAModule" && profile[0].depth == 0));
+            REQUIRE((profile[1].kind == Kind::EagerBinding && profile[1].name == "TestC" && profile[1].depth == 0));
+            REQUIRE((profile[2].kind == Kind::Construct && profile[2].name == "TestC" && profile[2].depth == 1));
+            REQUIRE((profile[3].kind == Kind::Construct && profile[3].name == "ITest" && profile[3].depth == 2));
+            REQUIRE(profile[1].totalNanos >= profile[2].totalNanos);
+            REQUIRE(profile[1].selfNanos == profile[1].totalNanos - profile[2].totalNanos);
+            REQUIRE(profile[2].selfNanos == profile[2].totalNanos - profile[3].totalNanos);
+
+            // Only startup is profiled
+            sl->getContext()->resolve<ITest>();
+            REQUIRE(sl->getStartupProfile().size() == 4);
+        }
+#endif
+
         SECTION("Binding to constant interface") {
             const TestNoSL ta = TestNoSL();
             
@@ -314,6 +1140,127 @@ TEST_CASE( "ServiceLocator", "[servicelocator]" ) {
             REQUIRE(all.size() == 2);
             REQUIRE(all[0]->getIt() == "TestA");
             REQUIRE(all[1]->getIt() == "TestB");
+
+            // afterResolve runs once every binding has been resolved
+            std::vector<std::string> log;
+            for(auto name : { "C", "D" }) {
+                std::string n = name;
+                sl->bind<ITest>(n).to<TestA>([&log, n] (const SLContext_sptr& slc) -> std::shared_ptr<TestA> {
+                    log.push_back("create " + n);
+                    slc->afterResolve([&log, n] (const SLContext_sptr& slc) { log.push_back("after " + n); });
+                    return std::make_shared<TestA>(slc);
+                });
+            }
+            all.clear();
+            slc->resolveAll<ITest>(&all);
+            REQUIRE(all.size() == 4);
+            REQUIRE(log == std::vector<std::string>({ "create C", "create D", "after C", "after D" }));
+        }
+
+        SECTION("Resolve All range") {
+            sl->bind<ITest>("A").to<TestA>().asSingleton();
+            auto child = sl->enter();
+            child->bind<ITest>("B").to<TestB>();
+            auto slc = child->getContext();
+
+            std::vector<std::string> its;
+            for(auto test : slc->resolveAllRange<ITest>()) {
+                its.push_back(test->getIt());
+            }
+            REQUIRE(its.size() == 2);
+            REQUIRE(its[0] == "TestB");
+            REQUIRE(its[1] == "TestA");
+
+            auto range = slc->resolveAllRange<ITest>();
+            auto it = range.begin();
+            ++it;
+            REQUIRE(*it == *it);
+            REQUIRE(++it == range.end());
+            REQUIRE(sl->getContext()->resolveAllRange<TestNoSL>().begin() == sl->getContext()->resolveAllRange<TestNoSL>().end());
+        }
+
+        SECTION("Resolve All overrides and priority") {
+            sl->bind<ITest>("A").to<TestA>();
+            sl->bind<ITest>("B").to<TestA>();
+            auto child = sl->enter();
+            child->bind<ITest>("B").to<TestB>();
+            auto slc = child->getContext();
+
+            // The child's B overrides its parent's
+            std::vector<std::shared_ptr<ITest>> all;
+            slc->resolveAll<ITest>(&all);
+            REQUIRE(all.size() == 2);
+            REQUIRE(all[0]->getIt() == "TestB");
+            REQUIRE(all[1]->getIt() == "TestA");
+
+            child->bind<ITest>("C").to<TestB>().priority(1);
+            sl->bind<ITest>("D").to<TestA>().priority(-1);
+            all.clear();
+            slc->resolveAll<ITest>(&all);
+            REQUIRE(all.size() == 4);
+            std::vector<std::string> its;
+            for(auto test : slc->resolveAllRange<ITest>()) {
+                its.push_back(test->getIt());
+            }
+            REQUIRE(its == std::vector<std::string>({ "TestA", "TestB", "TestA", "TestB" }));
+            REQUIRE(all[0]->getIt() == "TestA");
+            REQUIRE(all[3]->getIt() == "TestB");
+
+            // An Instance binding takes a priority too
+            auto first = std::make_shared<TestB>(slc);
+            child->bind<ITest>("E").toInstance(first).priority(-2);
+            all.clear();
+            slc->resolveAll<ITest>(&all);
+            REQUIRE(all.size() == 5);
+            REQUIRE(all[0] == first);
+        }
+
+        SECTION("Resolve All in parallel") {
+            sl->bind<ITest>("A").to<TestA>().asSingleton();
+            auto child = sl->enter();
+            child->bind<ITest>("B").to<TestB>();
+            child->bind<ITest>("C").to<TestA>();
+            auto slc = child->getContext();
+
+            std::vector<std::shared_ptr<ITest>> all;
+            slc->resolveAll<ITest>(&all, ServiceLocator::threadExecutor());
+            REQUIRE(all.size() == 3);
+            REQUIRE(all[0]->getIt() == "TestB");
+            REQUIRE(all[1]->getIt() == "TestA");
+            REQUIRE(all[2]->getIt() == "TestA");
+
+            child->bind<ITest>("D").to<TestB>([] (const SLContext_sptr& slc) -> std::shared_ptr<TestB> {
+                throw std::runtime_error("failed");
+            });
+            all.clear();
+            REQUIRE_THROWS_AS(slc->resolveAll<ITest>(&all, ServiceLocator::threadExecutor()), std::runtime_error);
+            REQUIRE(all.empty());
+        }
+
+        SECTION("Resolve All shared") {
+            sl->bind<ITest>("A").to<TestA>().asSingleton();
+            auto child = sl->enter();
+            auto slc = child->getContext();
+
+            auto first = slc->resolveAllShared<ITest>();
+            REQUIRE(first->size() == 1);
+            REQUIRE(slc->resolveAllShared<ITest>() == first);
+
+            // shutdown releases the cached array's Singletons too
+            std::weak_ptr<ITest> released = first->at(0);
+            first.reset();
+            sl->shutdown();
+            REQUIRE(released.expired());
+            first = slc->resolveAllShared<ITest>();
+            REQUIRE(first->at(0) == slc->resolve<ITest>("A"));
+
+            // A transient binding cannot be cached
+            sl->bind<ITest>("B").to<TestB>();
+            auto second = slc->resolveAllShared<ITest>();
+            REQUIRE(second != first);
+            REQUIRE(second->size() == 2);
+            REQUIRE(second->at(0) == first->at(0));
+            REQUIRE(slc->resolveAllShared<ITest>() != second);
         }
 
         SECTION("Eager binding") {
@@ -326,6 +1273,25 @@ TEST_CASE( "ServiceLocator", "[servicelocator]" ) {
 
             REQUIRE(TestEagerCount == 1);
         }
+
+        SECTION("Eager binding from many threads") {
+            auto before = TestEagerCount;
+            sl->bind<TestEager>().toSelfNoDependancy().asSingleton().eagerly();
+
+            // Every getContext() returns once the eager binding is made, and it is only made once
+            std::vector<int> seen(4);
+            std::vector<std::function<void()>> tasks;
+            for(std::size_t i = 0; i < seen.size(); i++) {
+                tasks.push_back([&sl, &seen, i] () {
+                    sl->getContext();
+                    seen[i] = TestEagerCount;
+                });
+            }
+            ServiceLocator::threadExecutor()(tasks);
+
+            REQUIRE(seen == std::vector<int>(4, before + 1));
+            REQUIRE(TestEagerCount == before + 1);
+        }
     }
 }
 